@@ -0,0 +1,126 @@
+/*
+** topdog-pdu.h - TopDog USB PDU layout, shared by the Wireshark dissector
+**	and the standalone topdog-stat tool.
+** Authors: Andrew D'Addesio <andrew@fatbag.net>
+** License: Public domain (no warranties)
+**
+** Plain C89 with no Wireshark or GLib dependency. Offsets are from the start
+** of a PDU or descriptor; all fields are little-endian.
+*/
+#ifndef TOPDOG_PDU_H
+#define TOPDOG_PDU_H
+
+/* PDU magics, as read little-endian from the first four bytes */
+#define TOPDOG_PDU_MCBW	0x4D434257	/* command request */
+#define TOPDOG_PDU_MCSW	0x4D435357	/* command response */
+#define TOPDOG_PDU_MTXD	0x4D545844	/* TX data: chain of WCBs */
+#define TOPDOG_PDU_MRXD	0x4D525844	/* RX data: chain of RxPDs */
+
+/* Firmware download PDUs, which start with a small type instead of a magic */
+#define TOPDOG_FW_RESPONSE		0
+#define TOPDOG_FW_SET			1
+#define TOPDOG_FW_SET_AND_EXECUTE	4
+#define TOPDOG_FW_SEQ_NUM	4	/* FW_RESPONSE */
+#define TOPDOG_FW_RESPONSE_LEN	8
+#define TOPDOG_FW_DEST_ADDR	4	/* FW_SET, FW_SET_AND_EXECUTE */
+#define TOPDOG_FW_DATA_SIZE	8
+#define TOPDOG_FW_HEADER_CRC	12	/* over the first 12 bytes */
+#define TOPDOG_FW_HEADER_LEN	16	/* followed by the data and its 4-byte CRC */
+#define TOPDOG_FW_CRC_LEN	4
+
+/* Command wrapper (MCBW/MCSW) */
+#define TOPDOG_CMD_TAG		4
+#define TOPDOG_CMD_CODE		12
+#define TOPDOG_CMD_LEN		14
+#define TOPDOG_CMD_SEQ_NUM	16
+#define TOPDOG_CMD_RESULT	18
+#define TOPDOG_CMD_HEADER_LEN	20
+#define TOPDOG_CMD_RESPONSE	0x8000	/* set in response command codes */
+#define TOPDOG_CMD_CODE_LIMIT	0x1200	/* all known codes are below this */
+
+/* WCB, one per MTXD descriptor; the 802.11 frame follows the header */
+#define TOPDOG_WCB_CTRL_STAT	4
+#define TOPDOG_WCB_TX_PRI	6
+#define TOPDOG_WCB_TX_FRAG_COUNT	7
+#define TOPDOG_WCB_QOS_CTRL	8
+#define TOPDOG_WCB_PKT_PTR	10
+#define TOPDOG_WCB_PKT_LEN	14
+#define TOPDOG_WCB_DEST_MAC	16
+#define TOPDOG_WCB_NEXT_PTR	22	/* 32 bits */
+#define TOPDOG_WCB_RATE_INFO	26
+#define TOPDOG_WCB_RESERVED	28
+#define TOPDOG_WCB_LEN		32
+
+/* RxPD, one per MRXD descriptor; the 802.11 frame follows the header */
+#define TOPDOG_RXPD_RX_CTRL	4
+#define TOPDOG_RXPD_RSSI	5
+#define TOPDOG_RXPD_CHANNEL	6
+#define TOPDOG_RXPD_NOISE_LVL	7
+#define TOPDOG_RXPD_PKT_LEN	8
+#define TOPDOG_RXPD_NEXT_PTR	10	/* 16 bits */
+#define TOPDOG_RXPD_QOS_CTRL	12
+#define TOPDOG_RXPD_CTRL	14
+#define TOPDOG_RXPD_RX_RATE_INFO	16
+#define TOPDOG_RXPD_TX_RATE_INFO	18
+#define TOPDOG_RXPD_LEN		20
+
+/* Accessors for the rate_info_flags bitfields. */
+#define TOPDOG_RATE_HT(r)	((r) & 0x0001)
+#define TOPDOG_RATE_SHORT_GI(r)	(((r) >> 1) & 0x1)
+#define TOPDOG_RATE_BW40(r)	(((r) >> 2) & 0x1)
+#define TOPDOG_RATE_MCS(r)	(((r) >> 3) & 0x3f)
+#define TOPDOG_RATE_ANT(r)	(((r) >> 11) & 0x3)
+
+/* Header length of a WCB or RxPD, and how much of it topdog_desc_lengths()
+** reads. */
+#define TOPDOG_DESC_HEADER_LEN(t)	((t) == TOPDOG_PDU_MTXD ? TOPDOG_WCB_LEN : TOPDOG_RXPD_LEN)
+#define TOPDOG_DESC_LENGTHS_END(t)	((t) == TOPDOG_PDU_MTXD ? TOPDOG_WCB_NEXT_PTR + 4 : TOPDOG_RXPD_NEXT_PTR + 2)
+
+#define TOPDOG_LE16(p)	((unsigned int)(p)[0] | (unsigned int)(p)[1] << 8)
+#define TOPDOG_LE32(p)	(TOPDOG_LE16(p) | (unsigned long)TOPDOG_LE16((p)+2) << 16)
+
+/* Upper bound on descriptors followed in one transfer. A 64 KiB URB packed
+** with minimum-size RxPDs stays well below this. */
+#define TOPDOG_MAX_CHAIN_HOPS 4096
+
+/* Advances offset by next_ptr. Returns 0 at the end of the chain. Offsets
+** must strictly increase, so a chain can neither repeat nor go backwards;
+** *bad is set if one doesn't. */
+static int topdog_chain_advance(unsigned int *offset, unsigned int next_ptr, int *bad)
+{
+	unsigned int next = *offset + next_ptr;
+
+	*bad = 0;
+	if (next_ptr == 0)
+		return 0;
+	if (next <= *offset) {
+		*bad = 1;
+		return 0;
+	}
+	if (next > 0xffff)
+		return 0;
+
+	*offset = next;
+	return 1;
+}
+
+/* Reads the packet length and next pointer of the descriptor at buf, which
+** must hold TOPDOG_DESC_LENGTHS_END bytes. Returns 0 if pdu_type isn't a WCB
+** or RxPD. */
+static int topdog_desc_lengths(const unsigned char *buf, unsigned long pdu_type,
+	unsigned int *pkt_len, unsigned int *next_ptr)
+{
+	if (pdu_type == TOPDOG_PDU_MTXD) {
+		*pkt_len = TOPDOG_LE16(buf + TOPDOG_WCB_PKT_LEN);
+		*next_ptr = (unsigned int)TOPDOG_LE32(buf + TOPDOG_WCB_NEXT_PTR);
+	} else if (pdu_type == TOPDOG_PDU_MRXD) {
+		*pkt_len = TOPDOG_LE16(buf + TOPDOG_RXPD_PKT_LEN);
+		*next_ptr = TOPDOG_LE16(buf + TOPDOG_RXPD_NEXT_PTR);
+	} else {
+		return 0;
+	}
+
+	return 1;
+}
+
+#endif
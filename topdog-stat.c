@@ -0,0 +1,1329 @@
+/*
+** topdog-stat.c - Multi-threaded batch statistics over TopDog usbmon captures.
+** Authors: Andrew D'Addesio <andrew@fatbag.net>
+** License: Public domain (no warranties)
+** Compile: gcc -Wall -ansi -O2 -pthread -o topdog-stat topdog-stat.c
+** Use: topdog-stat [-j threads] [-x] capture.pcap|capture.pcapng ...
+**      topdog-stat -q type=MTXD|cmd=0x1125|mac=00:11:22:33:44:55|channel=6 capture ...
+**
+** Reads pcap and pcapng files with the Linux usbmon link types (189 and 220)
+** through a read-only memory mapping, and reports command latency, RX radio
+** statistics and throughput over all files given. PDUs and descriptor chains
+** are parsed with the same layout and chain rules as the Wireshark dissector
+** (topdog-pdu.h). PDUs split across bulk transfers are not reassembled.
+**
+** The main thread walks record headers only, cutting each file into slices
+** of whole records and queueing each slice as soon as it is cut; a pool of
+** workers parses the slices into per-thread statistics while the rest of the
+** file is still being walked. How far this scales with cores has not been
+** measured.
+** Command requests and responses are paired within a slice; pairs that
+** straddle slices are resolved when the slices are merged in file order at
+** the end.
+**
+** -x also writes a sidecar index, <capture>.tdx, of the frame numbers and
+** file offsets of every record by PDU type, command code (request and
+** response alike), WCB destination MAC and RxPD channel. -q looks a key up
+** in the sidecars without touching the captures and prints one
+** "frame offset" line per matching record, so a repeated investigation
+** seeks straight to its records instead of dissecting the whole file.
+*/
+#define _POSIX_C_SOURCE 200112L
+#include <errno.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include "topdog-pdu.h"
+
+typedef unsigned long long u64;
+
+#define SLICE_BYTES	(32u << 20)
+#define MAX_THREADS	256
+#define LATENCY_BUCKETS	32	/* log2 microseconds */
+
+#define LINKTYPE_USB_LINUX		189
+#define LINKTYPE_USB_LINUX_MMAPPED	220
+#define USBMON_XFER_BULK	3
+
+#define PCAP_MAGIC_USEC	0xa1b2c3d4
+#define PCAP_MAGIC_NSEC	0xa1b23c4d
+#define PCAPNG_SHB	0x0A0D0D0A
+#define PCAPNG_IDB	1
+#define PCAPNG_PB	2	/* obsolete Packet Block */
+#define PCAPNG_SPB	3
+#define PCAPNG_EPB	6
+#define PCAPNG_BYTE_ORDER_MAGIC	0x1A2B3C4D
+
+/* One captured USB record, as handed to the TopDog parser. */
+typedef struct _usb_rec {
+	const unsigned char *data;	/* TopDog payload, after the usbmon header */
+	unsigned int len;	/* captured payload bytes */
+	unsigned int dev;	/* bus << 8 | device */
+	u64 ts;	/* nanoseconds since the epoch */
+	unsigned long frame;	/* Wireshark frame number */
+	u64 offset;	/* of the pcap record or pcapng block in the file */
+} usb_rec;
+
+/* Pending command requests: open addressing on (dev, tag, seq). */
+typedef struct _pending_cmd {
+	u64 key;	/* 0 = empty */
+	u64 ts;
+	unsigned int code;
+} pending_cmd;
+
+typedef struct _pending_table {
+	pending_cmd *slots;
+	unsigned long size, count;	/* size is a power of two */
+} pending_table;
+
+/* A response with no request in its own slice. */
+typedef struct _orphan_rsp {
+	u64 key;
+	u64 ts;
+} orphan_rsp;
+
+/* Sidecar index
+**
+** A .tdx file is a 32-byte header, a directory of keys sorted ascending and
+** one posting list per key. Each posting list holds the key's records in
+** frame order as pairs of LEB128 varints: frame number delta, file offset
+** delta. All integers are little-endian.
+**
+**   0  "TDX1"
+**   4  u32 number of keys
+**   8  u64 capture size \  the index is refused if either differs
+**  16  u64 capture mtime /
+**  24  u64 offset of the first posting list
+**  32  keys: u64 key, u64 posting list offset, u32 records, u32 zero
+*/
+#define TDX_MAGIC	"TDX1"
+#define TDX_HEADER_LEN	32
+#define TDX_DIR_ENTRY_LEN	24
+
+#define TDX_KEY(kind, value)	((u64)(kind) << 56 | (u64)(value))
+#define TDX_KIND_TYPE	1	/* value: PDU magic */
+#define TDX_KIND_CMD	2	/* value: command code without TOPDOG_CMD_RESPONSE */
+#define TDX_KIND_MAC	3	/* value: WCB destination MAC, first octet most significant */
+#define TDX_KIND_CHANNEL	4	/* value: RxPD channel */
+
+typedef struct _index_entry {
+	u64 key;
+	u64 offset;
+	unsigned long frame;
+} index_entry;
+
+/* A pcapng interface, or the single implicit interface of a pcap file */
+typedef struct _iface {
+	unsigned int linktype;
+	int tsresol;	/* if_tsresol option value; pcap files use 6 or 9 */
+} iface;
+
+typedef struct _slice {
+	const unsigned char *start, *end;	/* whole records */
+	int pcapng;
+	iface *ifaces;	/* copy of the section's interfaces as of the slice's end */
+	unsigned int num_ifaces;
+	const unsigned char *file;	/* start of the mapping, for record offsets */
+	unsigned long first_frame;
+	index_entry *entries;	/* -x: in frame order */
+	unsigned long num_entries, max_entries;
+	pending_table pending;	/* requests still open at the end of the slice */
+	orphan_rsp *orphans;
+	unsigned long num_orphans, max_orphans;
+	struct _slice *next;	/* file order */
+	struct _slice *next_queued;
+} slice;
+
+typedef struct _cmd_stats {
+	u64 count;
+	u64 sum_ns;
+	u64 min_ns, max_ns;
+	u64 buckets[LATENCY_BUCKETS];
+	u64 unanswered;
+} cmd_stats;
+
+typedef struct _rx_channel {
+	u64 count;
+	u64 rssi[256];
+	u64 snr[256];	/* SNR in dB, offset by 128 */
+} rx_channel;
+
+/* Everything a worker accumulates. Merging is element-wise addition. */
+typedef struct _stats {
+	u64 records, bulk, pdus[4];	/* MCBW, MCSW, MTXD, MRXD */
+	u64 first_ts, last_ts;
+	cmd_stats cmds[TOPDOG_CMD_CODE_LIMIT + 1];	/* last entry: other codes */
+	u64 unmatched_rsps;
+	rx_channel *channels[256];
+	u64 rx_descs, tx_descs;
+	u64 ht[2], mcs[64], bw40[2], short_gi[2], ant[4];
+	u64 rx_bytes, tx_bytes;
+	u64 *seconds;	/* rx, tx byte pairs per second since base_ts */
+	unsigned long num_seconds;
+} stats;
+
+/* A mapped capture file */
+typedef struct _capture {
+	const char *filename;
+	unsigned char *map;
+	size_t size;
+	iface *ifaces;
+	unsigned int num_ifaces, max_ifaces;
+	time_t mtime;
+	slice *first_slice, *last_slice;
+} capture;
+
+static int build_index;	/* -x */
+
+static u64 base_ts;	/* first record of the first file; start of the timeline */
+static slice *slices_head, *slices_tail;	/* every slice, in file order */
+
+/* Work queue */
+static pthread_mutex_t queue_lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t queue_cond = PTHREAD_COND_INITIALIZER;
+static slice *queue_head, *queue_tail;
+static int queue_done;
+
+static void *xmalloc(size_t size)
+{
+	void *p = calloc(1, size);
+
+	if (p == NULL) {
+		fprintf(stderr, "topdog-stat: out of memory\n");
+		exit(1);
+	}
+	return p;
+}
+
+static void *xrealloc(void *p, size_t size)
+{
+	p = realloc(p, size);
+	if (p == NULL) {
+		fprintf(stderr, "topdog-stat: out of memory\n");
+		exit(1);
+	}
+	return p;
+}
+
+static unsigned long hash_key(u64 key)
+{
+	key ^= key >> 33;
+	key *= 0xff51afd7ed558ccdULL;
+	key ^= key >> 33;
+	return (unsigned long)key;
+}
+
+static pending_cmd *pending_find(pending_table *t, u64 key)
+{
+	unsigned long i;
+
+	if (t->size == 0)
+		return NULL;
+	for (i = hash_key(key) & (t->size - 1); t->slots[i].key != 0; i = (i + 1) & (t->size - 1))
+		if (t->slots[i].key == key)
+			return &t->slots[i];
+	return NULL;
+}
+
+/* Inserts or replaces the request for key. Returns 1 if it replaced an
+** unanswered one, whose code is stored in *old_code. */
+static int pending_insert(pending_table *t, u64 key, u64 ts, unsigned int code, unsigned int *old_code)
+{
+	int replaced = 0;
+	pending_cmd *cmd;
+	unsigned long i;
+
+	if ((t->count + 1) * 2 > t->size) {
+		pending_table grown;
+
+		grown.size = t->size ? t->size * 2 : 64;
+		grown.count = 0;
+		grown.slots = (pending_cmd *)xmalloc(grown.size * sizeof(pending_cmd));
+		for (i = 0; i < t->size; i++)
+			if (t->slots[i].key != 0)
+				pending_insert(&grown, t->slots[i].key, t->slots[i].ts, t->slots[i].code, old_code);
+		free(t->slots);
+		*t = grown;
+	}
+
+	cmd = pending_find(t, key);
+	if (cmd == NULL) {
+		for (i = hash_key(key) & (t->size - 1); t->slots[i].key != 0; i = (i + 1) & (t->size - 1))
+			;
+		cmd = &t->slots[i];
+		t->count++;
+	} else {
+		*old_code = cmd->code;
+		replaced = 1;
+	}
+	cmd->key = key;
+	cmd->ts = ts;
+	cmd->code = code;
+	return replaced;
+}
+
+/* Removes cmd, shifting later entries of its probe run back into the gap. */
+static void pending_remove(pending_table *t, pending_cmd *cmd)
+{
+	unsigned long mask = t->size - 1;
+	unsigned long gap = (unsigned long)(cmd - t->slots), i = gap;
+
+	for (;;) {
+		unsigned long home;
+
+		i = (i + 1) & mask;
+		if (t->slots[i].key == 0)
+			break;
+		home = hash_key(t->slots[i].key) & mask;
+		if (((i - home) & mask) >= ((i - gap) & mask)) {
+			t->slots[gap] = t->slots[i];
+			gap = i;
+		}
+	}
+	t->slots[gap].key = 0;
+	t->count--;
+}
+
+static cmd_stats *get_cmd_stats(stats *st, unsigned int code)
+{
+	return &st->cmds[code < TOPDOG_CMD_CODE_LIMIT ? code : TOPDOG_CMD_CODE_LIMIT];
+}
+
+static void add_latency(stats *st, unsigned int code, u64 ns)
+{
+	cmd_stats *cs = get_cmd_stats(st, code);
+	u64 us = ns / 1000;
+	int bucket = 0;
+
+	while (us > 1 && bucket < LATENCY_BUCKETS - 1) {
+		us >>= 1;
+		bucket++;
+	}
+
+	if (cs->count == 0 || ns < cs->min_ns)
+		cs->min_ns = ns;
+	if (ns > cs->max_ns)
+		cs->max_ns = ns;
+	cs->count++;
+	cs->sum_ns += ns;
+	cs->buckets[bucket]++;
+}
+
+static void add_bytes(stats *st, u64 ts, int tx, unsigned int bytes)
+{
+	unsigned long second = ts > base_ts ? (unsigned long)((ts - base_ts) / 1000000000u) : 0;
+
+	if (second >= st->num_seconds) {
+		unsigned long n = st->num_seconds ? st->num_seconds : 64;
+
+		while (n <= second)
+			n *= 2;
+		st->seconds = (u64 *)xrealloc(st->seconds, n * 2 * sizeof(u64));
+		memset(st->seconds + st->num_seconds * 2, 0, (n - st->num_seconds) * 2 * sizeof(u64));
+		st->num_seconds = n;
+	}
+	st->seconds[second * 2 + tx] += bytes;
+	if (tx)
+		st->tx_bytes += bytes;
+	else
+		st->rx_bytes += bytes;
+}
+
+static void add_rxpd(stats *st, const unsigned char *rxpd)
+{
+	unsigned int rate = TOPDOG_LE16(rxpd + TOPDOG_RXPD_RX_RATE_INFO);
+	unsigned int rssi = rxpd[TOPDOG_RXPD_RSSI], noise = rxpd[TOPDOG_RXPD_NOISE_LVL];
+	rx_channel *channel = st->channels[rxpd[TOPDOG_RXPD_CHANNEL]];
+
+	if (channel == NULL)
+		channel = st->channels[rxpd[TOPDOG_RXPD_CHANNEL]] = (rx_channel *)xmalloc(sizeof(rx_channel));
+	channel->count++;
+	channel->rssi[rssi]++;
+	/* SNR = signal - noise = (-rssi) - (-noise_lvl) */
+	channel->snr[(unsigned char)(128 + noise - rssi)]++;
+
+	st->rx_descs++;
+	st->ht[TOPDOG_RATE_HT(rate)]++;
+	if (TOPDOG_RATE_HT(rate))
+		st->mcs[TOPDOG_RATE_MCS(rate)]++;
+	st->bw40[TOPDOG_RATE_BW40(rate)]++;
+	st->short_gi[TOPDOG_RATE_SHORT_GI(rate)]++;
+	st->ant[TOPDOG_RATE_ANT(rate)]++;
+}
+
+static void index_add(slice *sl, const usb_rec *rec, u64 key)
+{
+	index_entry *entry;
+
+	if (!build_index)
+		return;
+	/* A chain often repeats a MAC or channel; keep one entry per record. */
+	if (sl->num_entries != 0) {
+		unsigned long i;
+
+		for (i = sl->num_entries; i-- > 0 && sl->entries[i].frame == rec->frame; )
+			if (sl->entries[i].key == key)
+				return;
+	}
+	if (sl->num_entries == sl->max_entries) {
+		sl->max_entries = sl->max_entries ? sl->max_entries * 2 : 1024;
+		sl->entries = (index_entry *)xrealloc(sl->entries, sl->max_entries * sizeof(index_entry));
+	}
+	entry = &sl->entries[sl->num_entries++];
+	entry->key = key;
+	entry->offset = rec->offset;
+	entry->frame = rec->frame;
+}
+
+static u64 mac_key(const unsigned char *mac)
+{
+	u64 value = 0;
+	int i;
+
+	for (i = 0; i < 6; i++)
+		value = value << 8 | mac[i];
+	return TDX_KEY(TDX_KIND_MAC, value);
+}
+
+/* Walks an MTXD/MRXD chain within the captured data. */
+static void parse_chain(stats *st, slice *sl, const usb_rec *rec)
+{
+	unsigned int offset = 0, hops = 0;
+	int bad;
+
+	while (offset + 4 <= rec->len && hops++ < TOPDOG_MAX_CHAIN_HOPS) {
+		unsigned long pdu_type = TOPDOG_LE32(rec->data + offset);
+		unsigned int pkt_len, next_ptr;
+
+		if (pdu_type != TOPDOG_PDU_MTXD && pdu_type != TOPDOG_PDU_MRXD)
+			break;
+		if (offset + TOPDOG_DESC_LENGTHS_END(pdu_type) > rec->len)
+			break;
+		topdog_desc_lengths(rec->data + offset, pdu_type, &pkt_len, &next_ptr);
+
+		if (pdu_type == TOPDOG_PDU_MTXD) {
+			st->tx_descs++;
+			add_bytes(st, rec->ts, 1, pkt_len);
+			if (offset + TOPDOG_WCB_DEST_MAC + 6 <= rec->len)
+				index_add(sl, rec, mac_key(rec->data + offset + TOPDOG_WCB_DEST_MAC));
+		} else {
+			if (offset + TOPDOG_RXPD_LEN <= rec->len) {
+				add_rxpd(st, rec->data + offset);
+				index_add(sl, rec, TDX_KEY(TDX_KIND_CHANNEL, rec->data[offset + TOPDOG_RXPD_CHANNEL]));
+			}
+			add_bytes(st, rec->ts, 0, pkt_len);
+		}
+
+		if (!topdog_chain_advance(&offset, next_ptr, &bad))
+			break;
+	}
+}
+
+static void parse_topdog(stats *st, slice *sl, const usb_rec *rec)
+{
+	unsigned long magic;
+	unsigned int old_code;
+	u64 key;
+
+	if (rec->len < 4)
+		return;
+
+	magic = TOPDOG_LE32(rec->data);
+	switch (magic) {
+	case TOPDOG_PDU_MCBW:
+	case TOPDOG_PDU_MCSW:
+		if (rec->len < TOPDOG_CMD_HEADER_LEN)
+			return;
+		index_add(sl, rec, TDX_KEY(TDX_KIND_TYPE, magic));
+		index_add(sl, rec, TDX_KEY(TDX_KIND_CMD, TOPDOG_LE16(rec->data + TOPDOG_CMD_CODE) & ~TOPDOG_CMD_RESPONSE));
+		/* The same key as the dissector's TOPDOG_CMD_KEY, per device; +1 keeps it non-zero. */
+		key = ((u64)rec->dev << 32 | (u64)TOPDOG_LE16(rec->data + TOPDOG_CMD_TAG) << 16
+			| TOPDOG_LE16(rec->data + TOPDOG_CMD_SEQ_NUM)) + 1;
+		if (magic == TOPDOG_PDU_MCBW) {
+			st->pdus[0]++;
+			if (pending_insert(&sl->pending, key, rec->ts, TOPDOG_LE16(rec->data + TOPDOG_CMD_CODE), &old_code))
+				get_cmd_stats(st, old_code)->unanswered++;
+		} else {
+			pending_cmd *cmd = pending_find(&sl->pending, key);
+
+			st->pdus[1]++;
+			if (cmd != NULL) {
+				add_latency(st, cmd->code, rec->ts - cmd->ts);
+				pending_remove(&sl->pending, cmd);
+			} else {
+				if (sl->num_orphans == sl->max_orphans) {
+					sl->max_orphans = sl->max_orphans ? sl->max_orphans * 2 : 16;
+					sl->orphans = (orphan_rsp *)xrealloc(sl->orphans, sl->max_orphans * sizeof(orphan_rsp));
+				}
+				sl->orphans[sl->num_orphans].key = key;
+				sl->orphans[sl->num_orphans].ts = rec->ts;
+				sl->num_orphans++;
+			}
+		}
+		break;
+	case TOPDOG_PDU_MTXD:
+		st->pdus[2]++;
+		index_add(sl, rec, TDX_KEY(TDX_KIND_TYPE, magic));
+		parse_chain(st, sl, rec);
+		break;
+	case TOPDOG_PDU_MRXD:
+		st->pdus[3]++;
+		index_add(sl, rec, TDX_KEY(TDX_KIND_TYPE, magic));
+		parse_chain(st, sl, rec);
+		break;
+	}
+}
+
+/* Strips the usbmon header; returns 0 for anything but bulk data. */
+static int parse_usbmon(unsigned int linktype, const unsigned char *p, unsigned int caplen, u64 ts, usb_rec *rec)
+{
+	unsigned int header_len = linktype == LINKTYPE_USB_LINUX_MMAPPED ? 64 : 48;
+
+	if ((linktype != LINKTYPE_USB_LINUX && linktype != LINKTYPE_USB_LINUX_MMAPPED)
+		|| caplen <= header_len || p[9] != USBMON_XFER_BULK)
+		return 0;
+
+	rec->data = p + header_len;
+	rec->len = caplen - header_len;
+	rec->dev = (unsigned int)TOPDOG_LE16(p + 12) << 8 | p[11];
+	rec->ts = ts;
+	return 1;
+}
+
+/* Converts a pcapng timestamp in units of if_tsresol to nanoseconds. */
+static u64 pcapng_ts(u64 ticks, int tsresol)
+{
+	int exp = tsresol & 0x7f;
+	u64 div = 1;
+
+	if (tsresol & 0x80)
+		return (ticks >> exp) * 1000000000u + (((ticks & (((u64)1 << exp) - 1)) * 1000000000u) >> exp);
+
+	if (exp <= 9) {
+		while (exp++ < 9)
+			ticks *= 10;
+		return ticks;
+	}
+	while (exp-- > 9)
+		div *= 10;
+	return ticks / div;
+}
+
+static void add_record(stats *st, slice *sl, const iface *ifc, const unsigned char *p, unsigned int caplen,
+	u64 ts, usb_rec *rec)
+{
+	st->records++;
+	if (st->first_ts == 0 || ts < st->first_ts)
+		st->first_ts = ts;
+	if (ts > st->last_ts)
+		st->last_ts = ts;
+
+	if (parse_usbmon(ifc->linktype, p, caplen, ts, rec)) {
+		st->bulk++;
+		parse_topdog(st, sl, rec);
+	}
+}
+
+/* Record bounds were checked by the scanner. */
+static void run_slice(stats *st, slice *sl)
+{
+	const unsigned char *p = sl->start;
+	usb_rec rec;
+
+	rec.frame = sl->first_frame;
+	while (p < sl->end) {
+		rec.offset = (u64)(p - sl->file);
+		if (!sl->pcapng) {
+			unsigned int caplen = (unsigned int)TOPDOG_LE32(p + 8);
+			u64 ts = (u64)TOPDOG_LE32(p) * 1000000000u
+				+ pcapng_ts(TOPDOG_LE32(p + 4), sl->ifaces[0].tsresol);
+
+			add_record(st, sl, &sl->ifaces[0], p + 16, caplen, ts, &rec);
+			rec.frame++;
+			p += 16 + caplen;
+		} else {
+			unsigned long type = TOPDOG_LE32(p), block_len = TOPDOG_LE32(p + 4);
+
+			if (type == PCAPNG_EPB) {
+				unsigned long id = TOPDOG_LE32(p + 8);
+
+				if (id < sl->num_ifaces)
+					add_record(st, sl, &sl->ifaces[id], p + 28, (unsigned int)TOPDOG_LE32(p + 20),
+						pcapng_ts((u64)TOPDOG_LE32(p + 12) << 32 | TOPDOG_LE32(p + 16), sl->ifaces[id].tsresol),
+						&rec);
+			}
+			if (type == PCAPNG_EPB || type == PCAPNG_SPB || type == PCAPNG_PB)
+				rec.frame++;
+			p += block_len;
+		}
+	}
+}
+
+static void *worker(void *data)
+{
+	stats *st = (stats *)data;
+
+	for (;;) {
+		slice *sl;
+
+		pthread_mutex_lock(&queue_lock);
+		while (queue_head == NULL && !queue_done)
+			pthread_cond_wait(&queue_cond, &queue_lock);
+		sl = queue_head;
+		if (sl != NULL) {
+			queue_head = sl->next_queued;
+			if (queue_head == NULL)
+				queue_tail = NULL;
+		}
+		pthread_mutex_unlock(&queue_lock);
+
+		if (sl == NULL)
+			return NULL;
+		run_slice(st, sl);
+	}
+}
+
+/* Appends an empty slice starting at p to the file-order list. */
+static slice *new_slice(capture *cap, const unsigned char *p, int pcapng, unsigned long first_frame)
+{
+	slice *sl = (slice *)xmalloc(sizeof(slice));
+
+	sl->start = sl->end = p;
+	sl->pcapng = pcapng;
+	sl->file = cap->map;
+	sl->first_frame = first_frame;
+	if (slices_tail != NULL)
+		slices_tail->next = sl;
+	else
+		slices_head = sl;
+	slices_tail = sl;
+	if (cap->first_slice == NULL)
+		cap->first_slice = sl;
+	cap->last_slice = sl;
+	return sl;
+}
+
+static void add_iface(capture *cap, unsigned int linktype, int tsresol)
+{
+	if (cap->num_ifaces == cap->max_ifaces) {
+		cap->max_ifaces = cap->max_ifaces ? cap->max_ifaces * 2 : 4;
+		cap->ifaces = (iface *)xrealloc(cap->ifaces, cap->max_ifaces * sizeof(iface));
+	}
+	cap->ifaces[cap->num_ifaces].linktype = linktype;
+	cap->ifaces[cap->num_ifaces].tsresol = tsresol;
+	cap->num_ifaces++;
+}
+
+/* Reads the link type and if_tsresol option of an IDB. */
+static void scan_idb(capture *cap, const unsigned char *p, unsigned long block_len)
+{
+	unsigned long offset = 16;
+	int tsresol = 6;
+
+	while (offset + 4 <= block_len - 4) {
+		unsigned int code = TOPDOG_LE16(p + offset), len = TOPDOG_LE16(p + offset + 2);
+
+		if (code == 0 || offset + 4 + len > block_len - 4)
+			break;
+		if (code == 9 && len >= 1)
+			tsresol = p[offset + 4];
+		offset += 4 + ((len + 3) & ~3u);
+	}
+
+	add_iface(cap, TOPDOG_LE16(p + 8), tsresol);
+}
+
+/* Hands a finished slice to the workers. cap->ifaces may still grow, and
+** move, as the file is walked, so the slice gets its own copy of the
+** interfaces of its section; every EPB follows the IDB it refers to, so the
+** copy covers all of the slice's records. */
+static void queue_slice(const capture *cap, slice *sl, unsigned int section_base)
+{
+	sl->num_ifaces = cap->num_ifaces - section_base;
+	if (sl->num_ifaces != 0) {
+		sl->ifaces = (iface *)xmalloc(sl->num_ifaces * sizeof(iface));
+		memcpy(sl->ifaces, cap->ifaces + section_base, sl->num_ifaces * sizeof(iface));
+	}
+
+	pthread_mutex_lock(&queue_lock);
+	if (queue_tail != NULL)
+		queue_tail->next_queued = sl;
+	else
+		queue_head = sl;
+	queue_tail = sl;
+	pthread_cond_signal(&queue_cond);
+	pthread_mutex_unlock(&queue_lock);
+}
+
+/* Walks the record headers of a mapped file and cuts it into slices.
+** Returns 0 if the file isn't a little-endian pcap or pcapng file. */
+static int scan_capture(capture *cap)
+{
+	const unsigned char *p = cap->map, *end = cap->map + cap->size;
+	unsigned long magic;
+	slice *sl = NULL;
+	unsigned int section_base = 0;	/* first interface of the current pcapng section */
+	unsigned long frame = 1;
+	int pcapng;
+
+	if (cap->size < 24)
+		return 0;
+	magic = TOPDOG_LE32(p);
+	if (magic == PCAP_MAGIC_USEC || magic == PCAP_MAGIC_NSEC) {
+		pcapng = 0;
+		add_iface(cap, TOPDOG_LE16(p + 20), magic == PCAP_MAGIC_NSEC ? 9 : 6);
+		p += 24;
+	} else if (magic == PCAPNG_SHB && TOPDOG_LE32(p + 8) == PCAPNG_BYTE_ORDER_MAGIC) {
+		pcapng = 1;
+	} else {
+		return 0;
+	}
+
+	while (p < end) {
+		unsigned long remaining = (unsigned long)(end - p);
+		unsigned long record_len;
+		int is_frame = 1;
+		u64 ts = 0;
+
+		if (!pcapng) {
+			if (remaining < 16 || TOPDOG_LE32(p + 8) > remaining - 16)
+				break;
+			record_len = 16 + TOPDOG_LE32(p + 8);
+			ts = (u64)TOPDOG_LE32(p) * 1000000000u + pcapng_ts(TOPDOG_LE32(p + 4), cap->ifaces[0].tsresol);
+		} else {
+			unsigned long type;
+
+			if (remaining < 12)
+				break;
+			type = TOPDOG_LE32(p);
+			record_len = TOPDOG_LE32(p + 4);
+			if (record_len < 12 || (record_len & 3) || record_len > remaining)
+				break;
+			is_frame = type == PCAPNG_EPB || type == PCAPNG_SPB || type == PCAPNG_PB;
+
+			if (type == PCAPNG_SHB) {
+				if (record_len < 28 || TOPDOG_LE32(p + 8) != PCAPNG_BYTE_ORDER_MAGIC)
+					break;
+				/* Interface IDs restart in every section, so start a new slice. */
+				if (sl != NULL)
+					queue_slice(cap, sl, section_base);
+				section_base = cap->num_ifaces;
+				sl = NULL;
+				p += record_len;
+				continue;
+			} else if (type == PCAPNG_IDB) {
+				if (record_len < 20)
+					break;
+				scan_idb(cap, p, record_len);
+			} else if (type == PCAPNG_EPB) {
+				unsigned long id;
+
+				if (record_len < 32 || TOPDOG_LE32(p + 20) > record_len - 32)
+					break;
+				id = section_base + TOPDOG_LE32(p + 8);
+				if (id < cap->num_ifaces)
+					ts = pcapng_ts((u64)TOPDOG_LE32(p + 12) << 32 | TOPDOG_LE32(p + 16), cap->ifaces[id].tsresol);
+			}
+		}
+
+		if (base_ts == 0)
+			base_ts = ts;
+		if (sl != NULL && (unsigned long)(sl->end - sl->start) >= SLICE_BYTES) {
+			queue_slice(cap, sl, section_base);
+			sl = NULL;
+		}
+		if (sl == NULL)
+			sl = new_slice(cap, p, pcapng, frame);
+		p += record_len;
+		sl->end = p;
+		frame += is_frame;
+	}
+	if (sl != NULL)
+		queue_slice(cap, sl, section_base);
+
+	if (p < end)
+		fprintf(stderr, "topdog-stat: %s: truncated or corrupt after byte %lu\n",
+			cap->filename, (unsigned long)(p - cap->map));
+	return 1;
+}
+
+static void merge_stats(stats *total, stats *st)
+{
+	unsigned long i;
+	int j;
+
+	total->records += st->records;
+	total->bulk += st->bulk;
+	for (j = 0; j < 4; j++)
+		total->pdus[j] += st->pdus[j];
+	if (st->records != 0) {
+		if (total->first_ts == 0 || st->first_ts < total->first_ts)
+			total->first_ts = st->first_ts;
+		if (st->last_ts > total->last_ts)
+			total->last_ts = st->last_ts;
+	}
+
+	for (i = 0; i <= TOPDOG_CMD_CODE_LIMIT; i++) {
+		cmd_stats *to = &total->cmds[i];
+		const cmd_stats *from = &st->cmds[i];
+
+		if (from->count != 0) {
+			if (to->count == 0 || from->min_ns < to->min_ns)
+				to->min_ns = from->min_ns;
+			if (from->max_ns > to->max_ns)
+				to->max_ns = from->max_ns;
+			to->count += from->count;
+			to->sum_ns += from->sum_ns;
+			for (j = 0; j < LATENCY_BUCKETS; j++)
+				to->buckets[j] += from->buckets[j];
+		}
+		to->unanswered += from->unanswered;
+	}
+	total->unmatched_rsps += st->unmatched_rsps;
+
+	for (i = 0; i < 256; i++) {
+		rx_channel *from = st->channels[i];
+
+		if (from == NULL)
+			continue;
+		if (total->channels[i] == NULL) {
+			total->channels[i] = from;
+		} else {
+			total->channels[i]->count += from->count;
+			for (j = 0; j < 256; j++) {
+				total->channels[i]->rssi[j] += from->rssi[j];
+				total->channels[i]->snr[j] += from->snr[j];
+			}
+			free(from);
+		}
+		st->channels[i] = NULL;
+	}
+
+	total->rx_descs += st->rx_descs;
+	total->tx_descs += st->tx_descs;
+	for (j = 0; j < 2; j++) {
+		total->ht[j] += st->ht[j];
+		total->bw40[j] += st->bw40[j];
+		total->short_gi[j] += st->short_gi[j];
+	}
+	for (j = 0; j < 4; j++)
+		total->ant[j] += st->ant[j];
+	for (j = 0; j < 64; j++)
+		total->mcs[j] += st->mcs[j];
+
+	total->rx_bytes += st->rx_bytes;
+	total->tx_bytes += st->tx_bytes;
+	if (st->num_seconds > total->num_seconds) {
+		total->seconds = (u64 *)xrealloc(total->seconds, st->num_seconds * 2 * sizeof(u64));
+		memset(total->seconds + total->num_seconds * 2, 0,
+			(st->num_seconds - total->num_seconds) * 2 * sizeof(u64));
+		total->num_seconds = st->num_seconds;
+	}
+	for (i = 0; i < st->num_seconds * 2; i++)
+		total->seconds[i] += st->seconds[i];
+}
+
+/* Pairs the requests left open at the end of each slice with responses
+** orphaned at the start of later ones, in file order. */
+static void merge_slices(stats *total)
+{
+	pending_table open;
+	unsigned int old_code;
+	unsigned long i;
+	slice *sl;
+
+	memset(&open, 0, sizeof open);
+	for (sl = slices_head; sl != NULL; sl = sl->next) {
+		for (i = 0; i < sl->num_orphans; i++) {
+			pending_cmd *cmd = pending_find(&open, sl->orphans[i].key);
+
+			if (cmd != NULL) {
+				add_latency(total, cmd->code, sl->orphans[i].ts - cmd->ts);
+				pending_remove(&open, cmd);
+			} else {
+				total->unmatched_rsps++;
+			}
+		}
+
+		for (i = 0; i < sl->pending.size; i++) {
+			const pending_cmd *cmd = &sl->pending.slots[i];
+
+			if (cmd->key != 0 && pending_insert(&open, cmd->key, cmd->ts, cmd->code, &old_code))
+				get_cmd_stats(total, old_code)->unanswered++;
+		}
+	}
+
+	for (i = 0; i < open.size; i++)
+		if (open.slots[i].key != 0)
+			get_cmd_stats(total, open.slots[i].code)->unanswered++;
+	free(open.slots);
+}
+
+/* Returns the bin at which the running count reaches frac of total. */
+static int histogram_quantile(const u64 *bins, int num_bins, u64 total, double frac)
+{
+	u64 sum = 0;
+	int i;
+
+	for (i = 0; i < num_bins; i++) {
+		sum += bins[i];
+		if (sum > 0 && sum >= frac * total)
+			return i;
+	}
+
+	return num_bins - 1;
+}
+
+static double percent(u64 part, u64 total)
+{
+	return total ? 100.0 * part / total : 0;
+}
+
+/* Upper bound, in microseconds, of the latency bucket holding quantile frac */
+static double latency_quantile(const cmd_stats *cs, double frac)
+{
+	double us = (double)(2ul << histogram_quantile(cs->buckets, LATENCY_BUCKETS, cs->count, frac));
+
+	return us < cs->max_ns / 1000.0 ? us : cs->max_ns / 1000.0;
+}
+
+static void print_stats(const stats *st, int num_files, int num_threads)
+{
+	double duration = st->last_ts > st->first_ts ? (st->last_ts - st->first_ts) / 1e9 : 0;
+	u64 peak_rx = 0, peak_tx = 0;
+	unsigned long i;
+
+	printf("\n===================================================================\n");
+	printf("TopDog Batch Statistics\n");
+	printf("Files: %d  Threads: %d  Records: %llu  Bulk: %llu  Duration: %.3f s\n",
+		num_files, num_threads, st->records, st->bulk, duration);
+	printf("PDUs: MCBW %llu  MCSW %llu  MTXD %llu  MRXD %llu\n",
+		st->pdus[0], st->pdus[1], st->pdus[2], st->pdus[3]);
+
+	printf("\nCommand       Count  Unanswered   Min (us)   Avg (us)  p50 (us)  p99 (us)   Max (us)\n");
+	for (i = 0; i <= TOPDOG_CMD_CODE_LIMIT; i++) {
+		const cmd_stats *cs = &st->cmds[i];
+
+		if (cs->count == 0 && cs->unanswered == 0)
+			continue;
+		if (i < TOPDOG_CMD_CODE_LIMIT)
+			printf(" 0x%04lx", i);
+		else
+			printf("  other");
+		printf(" %11llu %11llu", cs->count, cs->unanswered);
+		if (cs->count != 0)
+			printf(" %10.1f %10.1f %9.0f %9.0f %10.1f\n", cs->min_ns / 1000.0,
+				(double)cs->sum_ns / cs->count / 1000.0, latency_quantile(cs, 0.5),
+				latency_quantile(cs, 0.99), cs->max_ns / 1000.0);
+		else
+			printf(" %10s %10s %9s %9s %10s\n", "-", "-", "-", "-", "-");
+	}
+	printf("Responses without a request: %llu\n", st->unmatched_rsps);
+
+	printf("\nRxPDs: %llu\n", st->rx_descs);
+	printf("Channel      Count   RSSI dBm (p10/p50/p90)    SNR dB (p10/p50/p90)\n");
+	for (i = 0; i < 256; i++) {
+		const rx_channel *channel = st->channels[i];
+
+		if (channel == NULL)
+			continue;
+		/* A larger RSSI magnitude is a weaker signal, so quantiles flip. */
+		printf("%7lu %10llu   %6d %6d %6d      %6d %6d %6d\n", i, channel->count,
+			-histogram_quantile(channel->rssi, 256, channel->count, 0.9),
+			-histogram_quantile(channel->rssi, 256, channel->count, 0.5),
+			-histogram_quantile(channel->rssi, 256, channel->count, 0.1),
+			histogram_quantile(channel->snr, 256, channel->count, 0.1) - 128,
+			histogram_quantile(channel->snr, 256, channel->count, 0.5) - 128,
+			histogram_quantile(channel->snr, 256, channel->count, 0.9) - 128);
+	}
+	printf("Legacy: %.1f%%  HT: %.1f%%\n",
+		percent(st->ht[0], st->rx_descs), percent(st->ht[1], st->rx_descs));
+	printf("Bandwidth: 20 MHz %.1f%%  40 MHz %.1f%%\n",
+		percent(st->bw40[0], st->rx_descs), percent(st->bw40[1], st->rx_descs));
+	printf("Guard interval: long %.1f%%  short %.1f%%\n",
+		percent(st->short_gi[0], st->rx_descs), percent(st->short_gi[1], st->rx_descs));
+	printf("Antenna: none %.1f%%  Ant0 %.1f%%  Ant1 %.1f%%  Ant0+Ant1 %.1f%%\n",
+		percent(st->ant[0], st->rx_descs), percent(st->ant[1], st->rx_descs),
+		percent(st->ant[2], st->rx_descs), percent(st->ant[3], st->rx_descs));
+	printf("MCS        Count\n");
+	for (i = 0; i < 64; i++)
+		if (st->mcs[i] != 0)
+			printf("%3lu %12llu  %5.1f%%\n", i, st->mcs[i], percent(st->mcs[i], st->ht[1]));
+
+	for (i = 0; i < st->num_seconds; i++) {
+		if (st->seconds[i * 2] > peak_rx)
+			peak_rx = st->seconds[i * 2];
+		if (st->seconds[i * 2 + 1] > peak_tx)
+			peak_tx = st->seconds[i * 2 + 1];
+	}
+	printf("\nThroughput      Descriptors        Bytes   Avg (bytes/s)  Peak (bytes/s)\n");
+	printf("RX %22llu %12llu %15.0f %15llu\n", st->rx_descs, st->rx_bytes,
+		duration > 0 ? st->rx_bytes / duration : 0, peak_rx);
+	printf("TX %22llu %12llu %15.0f %15llu\n", st->tx_descs, st->tx_bytes,
+		duration > 0 ? st->tx_bytes / duration : 0, peak_tx);
+	printf("===================================================================\n");
+}
+
+static int compare_entries(const void *a, const void *b)
+{
+	const index_entry *x = (const index_entry *)a, *y = (const index_entry *)b;
+
+	if (x->key != y->key)
+		return x->key < y->key ? -1 : 1;
+	if (x->frame != y->frame)
+		return x->frame < y->frame ? -1 : 1;
+	return 0;
+}
+
+static void put_le(unsigned char *p, u64 value, int len)
+{
+	int i;
+
+	for (i = 0; i < len; i++, value >>= 8)
+		p[i] = (unsigned char)value;
+}
+
+static u64 get_le64(const unsigned char *p)
+{
+	return (u64)TOPDOG_LE32(p) | (u64)TOPDOG_LE32(p + 4) << 32;
+}
+
+static unsigned int put_varint(unsigned char *p, u64 value)
+{
+	unsigned int len = 0;
+
+	while (value >= 0x80) {
+		p[len++] = (unsigned char)(value | 0x80);
+		value >>= 7;
+	}
+	p[len++] = (unsigned char)value;
+	return len;
+}
+
+static u64 get_varint(const unsigned char **p, const unsigned char *end)
+{
+	u64 value = 0;
+	int shift = 0;
+
+	while (*p < end && shift < 64) {
+		unsigned char byte = *(*p)++;
+
+		value |= (u64)(byte & 0x7f) << shift;
+		if (!(byte & 0x80))
+			break;
+		shift += 7;
+	}
+	return value;
+}
+
+/* Sorts the entries of every slice of cap by key and writes <capture>.tdx. */
+static int write_index(const capture *cap)
+{
+	unsigned long num_entries = 0, num_keys = 0, i, j;
+	unsigned char *dir, *postings;
+	size_t postings_len = 0;
+	index_entry *entries;
+	char *path;
+	FILE *f;
+	slice *sl;
+	int ok;
+
+	for (sl = cap->first_slice; sl != NULL; sl = sl == cap->last_slice ? NULL : sl->next)
+		num_entries += sl->num_entries;
+	entries = (index_entry *)xmalloc((num_entries + 1) * sizeof(index_entry));
+	num_entries = 0;
+	for (sl = cap->first_slice; sl != NULL; sl = sl == cap->last_slice ? NULL : sl->next) {
+		memcpy(entries + num_entries, sl->entries, sl->num_entries * sizeof(index_entry));
+		num_entries += sl->num_entries;
+	}
+	qsort(entries, num_entries, sizeof(index_entry), compare_entries);
+
+	for (i = 0; i < num_entries; i++)
+		if (i == 0 || entries[i].key != entries[i - 1].key)
+			num_keys++;
+
+	/* 10 bytes bounds a 64-bit varint. */
+	dir = (unsigned char *)xmalloc(num_keys * TDX_DIR_ENTRY_LEN + 1);
+	postings = (unsigned char *)xmalloc(num_entries * 20 + 1);
+	for (i = 0, j = 0; i < num_entries; j++) {
+		unsigned long start = i, frame = 0;
+		u64 offset = 0;
+
+		put_le(dir + j * TDX_DIR_ENTRY_LEN, entries[i].key, 8);
+		put_le(dir + j * TDX_DIR_ENTRY_LEN + 8, postings_len, 8);
+		for (; i < num_entries && entries[i].key == entries[start].key; i++) {
+			postings_len += put_varint(postings + postings_len, entries[i].frame - frame);
+			postings_len += put_varint(postings + postings_len, entries[i].offset - offset);
+			frame = entries[i].frame;
+			offset = entries[i].offset;
+		}
+		put_le(dir + j * TDX_DIR_ENTRY_LEN + 16, i - start, 4);
+		put_le(dir + j * TDX_DIR_ENTRY_LEN + 20, 0, 4);
+	}
+
+	path = (char *)xmalloc(strlen(cap->filename) + 5);
+	sprintf(path, "%s.tdx", cap->filename);
+	f = fopen(path, "wb");
+	if (f == NULL) {
+		fprintf(stderr, "topdog-stat: %s: %s\n", path, strerror(errno));
+		ok = 0;
+	} else {
+		unsigned char header[TDX_HEADER_LEN];
+
+		memcpy(header, TDX_MAGIC, 4);
+		put_le(header + 4, num_keys, 4);
+		put_le(header + 8, cap->size, 8);
+		put_le(header + 16, (u64)cap->mtime, 8);
+		put_le(header + 24, TDX_HEADER_LEN + num_keys * TDX_DIR_ENTRY_LEN, 8);
+		ok = fwrite(header, TDX_HEADER_LEN, 1, f) == 1
+			&& fwrite(dir, TDX_DIR_ENTRY_LEN, num_keys, f) == num_keys
+			&& fwrite(postings, 1, postings_len, f) == postings_len;
+		if (fclose(f) != 0 || !ok) {
+			fprintf(stderr, "topdog-stat: %s: write failed\n", path);
+			ok = 0;
+		}
+	}
+
+	free(path);
+	free(postings);
+	free(dir);
+	free(entries);
+	return ok;
+}
+
+/* Parses type=, cmd=, mac= or channel= into an index key. Returns 0 if invalid. */
+static int parse_query(const char *query, u64 *key)
+{
+	static const struct {
+		const char *name;
+		unsigned long magic;
+	} types[] = {
+		{ "MCBW", TOPDOG_PDU_MCBW },
+		{ "MCSW", TOPDOG_PDU_MCSW },
+		{ "MTXD", TOPDOG_PDU_MTXD },
+		{ "MRXD", TOPDOG_PDU_MRXD }
+	};
+	const char *value = strchr(query, '=');
+	char *end;
+	int i;
+
+	if (value == NULL)
+		return 0;
+	value++;
+
+	if (strncmp(query, "type=", 5) == 0) {
+		for (i = 0; i < 4; i++)
+			if (strcmp(value, types[i].name) == 0) {
+				*key = TDX_KEY(TDX_KIND_TYPE, types[i].magic);
+				return 1;
+			}
+		return 0;
+	} else if (strncmp(query, "cmd=", 4) == 0) {
+		unsigned long code = strtoul(value, &end, 0);
+
+		*key = TDX_KEY(TDX_KIND_CMD, code & ~TOPDOG_CMD_RESPONSE);
+		return *value != '\0' && *end == '\0' && code <= 0xffff;
+	} else if (strncmp(query, "mac=", 4) == 0) {
+		unsigned char mac[6];
+
+		for (i = 0; i < 6; i++) {
+			unsigned long octet = strtoul(value, &end, 16);
+
+			if (end == value || octet > 0xff || *end != (i < 5 ? ':' : '\0'))
+				return 0;
+			mac[i] = (unsigned char)octet;
+			value = end + 1;
+		}
+		*key = mac_key(mac);
+		return 1;
+	} else if (strncmp(query, "channel=", 8) == 0) {
+		unsigned long channel = strtoul(value, &end, 0);
+
+		*key = TDX_KEY(TDX_KIND_CHANNEL, channel);
+		return *value != '\0' && *end == '\0' && channel <= 0xff;
+	}
+
+	return 0;
+}
+
+/* Prints the frame number and file offset of every record of filename
+** under key, from its sidecar index. */
+static int query_index(const char *filename, u64 key, int print_name)
+{
+	const unsigned char *tdx, *dir, *p, *end;
+	unsigned long num_keys, lo, hi;
+	struct stat capture_st, st;
+	char *path;
+	size_t size;
+	int fd, ok = 0;
+
+	path = (char *)xmalloc(strlen(filename) + 5);
+	sprintf(path, "%s.tdx", filename);
+	if (stat(filename, &capture_st) != 0 || (fd = open(path, O_RDONLY)) < 0) {
+		fprintf(stderr, "topdog-stat: %s: %s; build it with -x\n", path, strerror(errno));
+		free(path);
+		return 0;
+	}
+	if (fstat(fd, &st) != 0 || st.st_size < TDX_HEADER_LEN) {
+		fprintf(stderr, "topdog-stat: %s: not an index\n", path);
+		close(fd);
+		free(path);
+		return 0;
+	}
+	size = (size_t)st.st_size;
+	tdx = (const unsigned char *)mmap(NULL, size, PROT_READ, MAP_PRIVATE, fd, 0);
+	close(fd);
+	if (tdx == (const unsigned char *)MAP_FAILED) {
+		fprintf(stderr, "topdog-stat: %s: cannot map file\n", path);
+		free(path);
+		return 0;
+	}
+
+	num_keys = TOPDOG_LE32(tdx + 4);
+	if (memcmp(tdx, TDX_MAGIC, 4) != 0 || get_le64(tdx + 24) != TDX_HEADER_LEN + (u64)num_keys * TDX_DIR_ENTRY_LEN
+		|| get_le64(tdx + 24) > size) {
+		fprintf(stderr, "topdog-stat: %s: not an index\n", path);
+	} else if (get_le64(tdx + 8) != (u64)capture_st.st_size || get_le64(tdx + 16) != (u64)capture_st.st_mtime) {
+		fprintf(stderr, "topdog-stat: %s: stale; %s has changed since it was indexed\n", path, filename);
+	} else {
+		ok = 1;
+		dir = tdx + TDX_HEADER_LEN;
+		end = tdx + size;
+		if (print_name)
+			printf("%s:\n", filename);
+
+		for (lo = 0, hi = num_keys; lo < hi; ) {
+			unsigned long mid = lo + (hi - lo) / 2;
+
+			if (get_le64(dir + mid * TDX_DIR_ENTRY_LEN) < key)
+				lo = mid + 1;
+			else
+				hi = mid;
+		}
+		if (lo < num_keys && get_le64(dir + lo * TDX_DIR_ENTRY_LEN) == key) {
+			unsigned long count = TOPDOG_LE32(dir + lo * TDX_DIR_ENTRY_LEN + 16), frame = 0, i;
+			u64 postings = get_le64(tdx + 24) + get_le64(dir + lo * TDX_DIR_ENTRY_LEN + 8), offset = 0;
+
+			p = postings < size ? tdx + postings : end;
+			for (i = 0; i < count && p < end; i++) {
+				frame += (unsigned long)get_varint(&p, end);
+				offset += get_varint(&p, end);
+				printf("%lu %llu\n", frame, offset);
+			}
+		}
+	}
+
+	munmap((void *)tdx, size);
+	free(path);
+	return ok;
+}
+
+int main(int argc, char *argv[])
+{
+	pthread_t threads[MAX_THREADS];
+	stats *thread_stats[MAX_THREADS];
+	capture *captures;
+	stats *total;
+	long num_threads = sysconf(_SC_NPROCESSORS_ONLN);
+	const char *query = NULL;
+	int first_file = 1, num_files = 0, i, ok = 1;
+	u64 key;
+
+	while (first_file < argc && argv[first_file][0] == '-') {
+		if (strcmp(argv[first_file], "-x") == 0) {
+			build_index = 1;
+			first_file++;
+		} else if (first_file + 1 < argc && strcmp(argv[first_file], "-j") == 0) {
+			num_threads = atol(argv[first_file + 1]);
+			first_file += 2;
+		} else if (first_file + 1 < argc && strcmp(argv[first_file], "-q") == 0) {
+			query = argv[first_file + 1];
+			first_file += 2;
+		} else {
+			break;
+		}
+	}
+	if (first_file >= argc || (query != NULL && !parse_query(query, &key))) {
+		fprintf(stderr, "Usage: topdog-stat [-j threads] [-x] capture.pcap|capture.pcapng ...\n"
+			"       topdog-stat -q type=MTXD|cmd=0x1125|mac=00:11:22:33:44:55|channel=6 capture ...\n");
+		return 1;
+	}
+
+	if (query != NULL) {
+		for (i = first_file; i < argc; i++)
+			ok &= query_index(argv[i], key, argc - first_file > 1);
+		return !ok;
+	}
+
+	if (num_threads < 1)
+		num_threads = 1;
+	else if (num_threads > MAX_THREADS)
+		num_threads = MAX_THREADS;
+
+	for (i = 0; i < num_threads; i++) {
+		thread_stats[i] = (stats *)xmalloc(sizeof(stats));
+		if (pthread_create(&threads[i], NULL, worker, thread_stats[i]) != 0) {
+			fprintf(stderr, "topdog-stat: cannot create thread\n");
+			return 1;
+		}
+	}
+
+	captures = (capture *)xmalloc((argc - first_file) * sizeof(capture));
+	for (i = first_file; i < argc; i++) {
+		capture *cap = &captures[num_files];
+		struct stat st;
+		int fd;
+
+		memset(cap, 0, sizeof *cap);
+		cap->filename = argv[i];
+		fd = open(argv[i], O_RDONLY);
+		if (fd < 0 || fstat(fd, &st) != 0) {
+			fprintf(stderr, "topdog-stat: %s: %s\n", argv[i], strerror(errno));
+			if (fd >= 0)
+				close(fd);
+			continue;
+		}
+		cap->size = (size_t)st.st_size;
+		cap->mtime = st.st_mtime;
+		cap->map = cap->size ? (unsigned char *)mmap(NULL, cap->size, PROT_READ, MAP_PRIVATE, fd, 0) : NULL;
+		close(fd);
+		if (cap->map == NULL || cap->map == (unsigned char *)MAP_FAILED) {
+			fprintf(stderr, "topdog-stat: %s: cannot map file\n", argv[i]);
+			continue;
+		}
+		posix_madvise(cap->map, cap->size, POSIX_MADV_SEQUENTIAL);
+
+		if (!scan_capture(cap)) {
+			fprintf(stderr, "topdog-stat: %s: not a little-endian pcap or pcapng file\n", argv[i]);
+			munmap(cap->map, cap->size);
+			continue;
+		}
+		num_files++;
+	}
+
+	pthread_mutex_lock(&queue_lock);
+	queue_done = 1;
+	pthread_cond_broadcast(&queue_cond);
+	pthread_mutex_unlock(&queue_lock);
+
+	total = (stats *)xmalloc(sizeof(stats));
+	for (i = 0; i < num_threads; i++) {
+		pthread_join(threads[i], NULL);
+		merge_stats(total, thread_stats[i]);
+	}
+	merge_slices(total);
+
+	print_stats(total, num_files, (int)num_threads);
+
+	for (i = 0; i < num_files; i++) {
+		if (build_index)
+			ok &= write_index(&captures[i]);
+		munmap(captures[i].map, captures[i].size);
+	}
+	return !ok;
+}
@@ -15,10 +15,20 @@
 ** Control field. (Maybe we need to produce a patch for packet-ieee802.11.c.)
 */
 #include <stdio.h>
+#include <string.h>
 #include <gmodule.h>
 #include <wireshark/config.h>
 #include <wireshark/epan/packet.h>
+#include <wireshark/epan/proto_data.h>
+#include <wireshark/epan/expert.h>
+#include <wireshark/epan/prefs.h>
+#include <wireshark/epan/uat.h>
+#include <wireshark/epan/tap.h>
+#include <wireshark/epan/export_object.h>
+#include <wireshark/epan/stat_tap_ui.h>
+#include <wireshark/epan/srt_table.h>
 #include <wireshark/epan/dissectors/packet-usb.h>
+#include "topdog-pdu.h"
 
 /* Symbols exported by this library */
 G_MODULE_EXPORT const gchar version[] = "0";
@@ -26,9 +36,14 @@ G_MODULE_EXPORT void plugin_register(void);
 G_MODULE_EXPORT void plugin_reg_handoff(void);
 
 /* TopDog protocol handles */
-/* static dissector_handle_t topdog_handle = NULL; */
+static dissector_handle_t topdog_handle = NULL;
+static dissector_handle_t topdog_product_handle = NULL;
 static dissector_handle_t wlan_handle = NULL;
 static int proto_topdog = -1;
+static int topdog_tap = -1;
+static int topdog_eo_tap = -1;
+static int topdog_rx_tap = -1;
+static int topdog_tx_tap = -1;
 static int hf_pdu_type = -1;
 static int hf_fw_seq_num = -1;
 static int hf_fw_dest_addr = -1;
@@ -36,6 +51,14 @@ static int hf_fw_data_size = -1;
 static int hf_fw_header_checksum = -1;
 static int hf_fw_data = -1;
 static int hf_fw_data_checksum = -1;
+static int hf_fw_header_checksum_status = -1;
+static int hf_fw_data_checksum_status = -1;
+static int hf_fw_response_in = -1;
+static int hf_fw_request_in = -1;
+static int hf_fw_time = -1;
+static int hf_response_in = -1;
+static int hf_request_in = -1;
+static int hf_time = -1;
 static int hf_tag = -1;
 static int hf_transfer_len = -1;
 static int hf_fun_flag = -1;
@@ -47,6 +70,60 @@ static int hf_cmd_len = -1;
 static int hf_cmd_seq_num = -1;
 static int hf_cmd_result = -1;
 static int hf_cmd_body = -1;
+static int hf_cmd_action = -1;
+static int hf_hw_spec_hw_rev = -1;
+static int hf_hw_spec_host_interface = -1;
+static int hf_hw_spec_num_mcaddrs = -1;
+static int hf_hw_spec_perm_addr = -1;
+static int hf_hw_spec_region_code = -1;
+static int hf_hw_spec_fw_rev = -1;
+static int hf_hw_spec_ps_cookie = -1;
+static int hf_hw_spec_caps = -1;
+static int hf_hw_spec_mcs_bitmap = -1;
+static int hf_hw_spec_rx_queue_ptr = -1;
+static int hf_hw_spec_num_tx_queues = -1;
+static int hf_hw_spec_tx_queue_ptr = -1;
+static int hf_hw_spec_caps2 = -1;
+static int hf_hw_spec_num_tx_desc_per_queue = -1;
+static int hf_hw_spec_total_rxd = -1;
+static int hf_rf_channel_channel = -1;
+static int hf_rf_channel_flags = -1;
+static int hf_edca_txop = -1;
+static int hf_edca_log_cw_max = -1;
+static int hf_edca_log_cw_min = -1;
+static int hf_edca_aifs = -1;
+static int hf_edca_txq = -1;
+static int hf_set_rate_legacy_rates = -1;
+static int hf_set_rate_mcs_set = -1;
+static int hf_new_stn_aid = -1;
+static int hf_new_stn_mac_addr = -1;
+static int hf_new_stn_stn_id = -1;
+static int hf_new_stn_action = -1;
+static int hf_new_stn_legacy_rates = -1;
+static int hf_new_stn_ht_rates = -1;
+static int hf_new_stn_cap_info = -1;
+static int hf_new_stn_ht_cap_info = -1;
+static int hf_new_stn_mac_ht_param_info = -1;
+static int hf_new_stn_control_channel = -1;
+static int hf_new_stn_add_channel = -1;
+static int hf_new_stn_op_mode = -1;
+static int hf_new_stn_stbc = -1;
+static int hf_new_stn_is_qos_sta = -1;
+static int hf_new_stn_fw_sta_ptr = -1;
+static int hf_bastream_action = -1;
+static int hf_bastream_flags = -1;
+static int hf_bastream_idle_thrs = -1;
+static int hf_bastream_bar_thrs = -1;
+static int hf_bastream_window_size = -1;
+static int hf_bastream_peer_mac_addr = -1;
+static int hf_bastream_dialog_token = -1;
+static int hf_bastream_tid = -1;
+static int hf_bastream_queue_id = -1;
+static int hf_bastream_param_info = -1;
+static int hf_bastream_ba_context = -1;
+static int hf_bastream_curr_seq_no = -1;
+static int hf_bastream_sta_src_mac_addr = -1;
+static int hf_rateadapt_mode = -1;
 static int hf_wcb_ctrl_stat = -1;
 static int hf_wcb_tx_pri = -1;
 static int hf_wcb_tx_frag_count = -1;
@@ -56,6 +133,8 @@ static int hf_wcb_pkt_len = -1;
 static int hf_wcb_dest_mac = -1;
 static int hf_wcb_next_ptr = -1;
 static int hf_wcb_rate_info = -1;
+static int hf_wcb_phy_rate = -1;
+static int hf_wcb_airtime = -1;
 static int hf_wcb_reserved = -1;
 static int hf_rxpd_rx_ctrl = -1;
 static int hf_rxpd_rssi = -1;
@@ -67,6 +146,9 @@ static int hf_rxpd_qos_ctrl = -1;
 static int hf_rxpd_rxpd_ctrl = -1;
 static int hf_rxpd_rx_rate_info = -1;
 static int hf_rxpd_tx_rate_info = -1;
+static int hf_rxpd_rx_phy_rate = -1;
+static int hf_rxpd_tx_phy_rate = -1;
+static int hf_rxpd_airtime = -1;
 static int hf_qos_ctrl_tid = -1;
 static int hf_qos_ctrl_eos = -1;
 static int hf_qos_ctrl_ack_policy = -1;
@@ -87,19 +169,245 @@ static int hf_rxpd_ctrl_error_type = -1;
 static int hf_rxpd_ctrl_key_index = -1;
 static int hf_rxpd_ctrl_reserved = -1;
 static int hf_wlan_pkt = -1;
+static int hf_chain_len = -1;
+static int hf_urb_len = -1;
+static int hf_urb_payload_len = -1;
+static int hf_urb_header_len = -1;
+static int hf_urb_padding = -1;
+static int hf_wcb_ring_occupancy = -1;
+static int hf_wcb_ring_high_water = -1;
+static int hf_wcb_ring_size = -1;
+static int hf_reassembled_in = -1;
+static int hf_fragment_first = -1;
+static int hf_fragment_count = -1;
+static int hf_reassembled_len = -1;
 static gint ett_topdog = -1;
 static gint ett_qos_ctrl = -1;
 static gint ett_rate_info = -1;
 static gint ett_rxpd_ctrl = -1;
+static gint ett_cmd_body = -1;
+static expert_field ei_chain_bad_next_ptr = EI_INIT;
+static expert_field ei_chain_too_long = EI_INIT;
+static expert_field ei_fw_bad_checksum = EI_INIT;
+static expert_field ei_cmd_no_response = EI_INIT;
+static expert_field ei_state_evicted = EI_INIT;
+static expert_field ei_tx_ring_full = EI_INIT;
+static expert_field ei_truncated = EI_INIT;
+
+/* Limits on the state kept for matching and reassembly, so that long live
+** captures don't grow without bound. Zero means unlimited. */
+static guint topdog_max_pending_cmds = 1024;	/* per device */
+static guint topdog_max_fw_image_kb = 16384;	/* per image */
+
+/* Bulk endpoints that miss this many times without ever matching are
+** no longer probed by the heuristic. Transfers shaped like a firmware
+** download, which precedes the first MCBW, are not counted as misses. */
+#define TOPDOG_HEUR_MISS_LIMIT 16
+
+/* Heuristic verdict for one USB bulk endpoint, keyed by TOPDOG_HEUR_KEY and
+** created on the endpoint's first match or counted miss. Frame numbers are
+** kept so that redissection makes the same choice as the first pass did. */
+typedef struct _topdog_heur_state {
+	guint32 misses;
+	guint32 pinned_in;
+	guint32 rejected_in;
+} topdog_heur_state;
+
+#define TOPDOG_HEUR_KEY(u) (((guint32)(u)->bus_id << 16) | ((guint32)((u)->device_address & 0xff) << 8) \
+	| ((u)->endpoint & 0x0f) | ((u)->direction == P2P_DIR_RECV ? 0x10 : 0))
+
+static wmem_map_t *topdog_heur_states = NULL;
+
+/* USB devices known to speak TopDog. The built-in 07d1:3b11 is always present;
+** rebranded dongles are added through the "usb_devices" UAT preference. */
+#define TOPDOG_DEFAULT_VID 0x07d1
+#define TOPDOG_DEFAULT_PID 0x3b11
+#define TOPDOG_USB_PRODUCT(vid, pid) (((guint32)(vid) << 16) | (pid))
+
+typedef struct _topdog_device_t {
+	guint vid;
+	guint pid;
+} topdog_device_t;
+
+static topdog_device_t *topdog_devices = NULL;
+static guint num_topdog_devices = 0;
+static GHashTable *topdog_products = NULL;
+
+/* One firmware chunk, copied out of the frame exactly once. */
+typedef struct _topdog_fw_extent {
+	guint32 addr;
+	guint32 len;
+	const guint8 *data;
+} topdog_fw_extent;
+
+/* A firmware download in progress, as a sparse map of the device memory
+** written so far. Completed by FW_SET_AND_EXECUTE. */
+typedef struct _topdog_fw_image {
+	wmem_tree_t *extents;	/* topdog_fw_extent, keyed by destination address */
+	guint32 num_chunks;
+	guint64 num_bytes;
+	gboolean discarded;	/* hit topdog_max_fw_image_kb; extents freed */
+	guint32 entry_addr;
+	guint16 bus_id;
+	guint16 device_address;
+} topdog_fw_image;
+
+/* A request (FW_SET or MCBW) awaiting its response. */
+typedef struct _topdog_pending {
+	struct _topdog_frame_info *info;
+	guint32 frame;
+	nstime_t ts;
+	guint32 key;
+	struct _topdog_pending *prev, *next;	/* age order, oldest first */
+} topdog_pending;
+
+/* Device-side TX ring of one priority, as seen from the host. Each WCB sent
+** to the device takes a slot. A slot is released when the device hands the
+** WCB back, when the host reuses its packet buffer, or, if the ring is full,
+** when a new WCB forces the oldest one out. Until a slot has been released
+** one of the first two ways, the host may simply never recycle its buffer
+** addresses, so a full ring is not reported as such. */
+#define TOPDOG_NUM_TX_PRI	8
+#define TOPDOG_DEFAULT_TX_RING	128	/* mwl8k's MWL8K_TX_DESCS */
+#define TOPDOG_MAX_TX_RING	4096
+
+typedef struct _topdog_tx_ring {
+	guint32 size;
+	guint32 *ptrs;	/* FIFO of pkt_ptrs in submission order; 0 = released */
+	wmem_map_t *slots;	/* pkt_ptr -> FIFO index + 1 */
+	guint32 head, used;	/* FIFO window, released entries included */
+	guint32 live;	/* occupancy */
+	guint32 high_water;
+	gboolean recycled;	/* a slot has been released by reuse or return */
+} topdog_tx_ring;
+
+/* A PDU split across consecutive bulk transfers on one endpoint. Each
+** fragment is copied once into data, which grows by doubling; the completed
+** buffer is handed to the PDU as is, with no defragmentation pass. */
+#define TOPDOG_MAX_PDU_LEN	(0x10000 + 0x10000 + 64)
+#define TOPDOG_NUM_ENDPOINTS	32	/* 16 endpoint numbers, IN and OUT */
+
+typedef struct _topdog_reasm_pdu {
+	guint32 first_frame;
+	guint32 last_frame;	/* 0 until complete */
+	guint32 num_fragments;
+	gboolean abandoned;	/* never completed; the first frame stands alone */
+	guint8 *data;
+	guint32 len;
+	guint32 alloc;
+} topdog_reasm_pdu;
+
+/* State kept per USB device (both bulk endpoints), keyed by bus and address. */
+typedef struct _topdog_dev_info {
+	topdog_fw_image *fw_image;
+	topdog_pending fw_pending;	/* info is NULL when no chunk is outstanding */
+	wmem_map_t *pending_cmds;	/* topdog_pending, keyed by TOPDOG_CMD_KEY */
+	topdog_pending *oldest_cmd, *newest_cmd;
+	guint32 num_pending_cmds;
+	guint32 tx_ring_size;	/* from GET_HW_SPEC, 0 until seen */
+	topdog_tx_ring tx_rings[TOPDOG_NUM_TX_PRI];
+	topdog_reasm_pdu *reasm[TOPDOG_NUM_ENDPOINTS];	/* in progress, per endpoint */
+} topdog_dev_info;
+
+#define TOPDOG_CMD_KEY(tag, seq_num) (((guint32)(tag) << 16) | (seq_num))
+
+static wmem_map_t *topdog_dev_infos = NULL;
+
+/* One descriptor of a transfer, as found by the first-pass chain walk. */
+typedef struct _topdog_desc {
+	guint32 pdu_type;
+	guint16 offset;
+	guint16 pkt_len;
+	/* WCBs only, set on the first pass by track_tx_ring */
+	gboolean ring_tracked;
+	gboolean ring_full;
+	guint16 ring_occupancy;
+	guint16 ring_high_water;
+	guint16 ring_size;
+} topdog_desc;
+
+#define TOPDOG_CHAIN_OK			0
+#define TOPDOG_CHAIN_BAD_NEXT_PTR	1
+#define TOPDOG_CHAIN_TOO_LONG		2
+
+/* Per-frame summary, computed once on the first pass and kept in file-scoped
+** proto data so tree-less passes (tshark without -V, taps) don't have to
+** re-parse the frame. */
+typedef struct _topdog_frame_info {
+	guint32 pdu_type;
+	guint16 cmd;
+	guint16 tag;
+	guint32 seq_num;
+	guint32 chain_count;
+	guint8 chain_status;
+	gboolean truncated;	/* captured length ends before the chain or a payload does */
+	topdog_desc *descs;	/* chain_count entries, in chain order */
+	guint32 urb_len;	/* MTXD/MRXD: transfer length and its breakdown */
+	guint32 payload_bytes;
+	guint32 header_bytes;
+	gboolean fw_crc_computed;
+	guint32 fw_header_crc;
+	guint32 fw_data_crc;
+	guint32 fw_dest_addr;
+	guint32 fw_data_size;
+	guint32 peer_frame;	/* requests: response in; responses: request in */
+	nstime_t rtt;
+	guint32 evictions;	/* tracked entries this frame pushed out */
+	gboolean evicted;	/* this frame's own state was pushed out */
+	topdog_fw_image *fw_image;	/* set on the frame that completes an image */
+	topdog_reasm_pdu *reasm;	/* set on every transfer of a fragmented PDU */
+	guint8 rf_channel;	/* RF_CHANNEL requests: the channel switched to */
+	guint32 dev_key;	/* bus << 16 | device address */
+} topdog_frame_info;
+
+/* Record published to the "topdog.rx" tap for every RxPD in a transfer.
+** RSSI and noise are magnitudes: the level in dBm is their negation. */
+typedef struct _topdog_rx_info {
+	guint8 rx_ctrl;
+	guint8 rssi;
+	guint8 channel;
+	guint8 noise_lvl;
+	guint16 pkt_len;
+	guint16 qos_ctrl;
+	guint16 rxpd_ctrl;
+	guint16 rx_rate_info;
+	guint16 tx_rate_info;
+	tvbuff_t *tvb;	/* the 802.11 frame, valid while the taps run */
+	guint32 wlan_offset;
+	gint wlan_len;	/* 0 if none of the frame was captured */
+} topdog_rx_info;
+
+/* Record published to the "topdog.tx" tap for every WCB in a transfer. */
+typedef struct _topdog_tx_info {
+	guint16 ctrl_stat;
+	guint8 tx_pri;
+	guint8 tx_frag_count;
+	guint16 qos_ctrl;
+	guint16 pkt_len;
+	guint32 pkt_ptr;
+	guint32 next_ptr;
+	guint8 dest_mac[6];
+	guint16 rate_info;
+	gboolean ring_tracked;
+	guint16 ring_occupancy;
+	guint16 ring_size;
+	gboolean ring_full;
+	tvbuff_t *tvb;	/* as in topdog_rx_info */
+	guint32 wlan_offset;
+	gint wlan_len;
+} topdog_tx_info;
+
+/* HT mode, short GI, bandwidth and MCS: everything the PHY rate depends on. */
+#define TOPDOG_RATE_INDEX(r)	((r) & 0x01ff)
 
 static const value_string topdog_types[] = {
-	{0x00000000, "FW_RESPONSE"},
-	{0x00000001, "FW_SET"},
-	{0x00000004, "FW_SET_AND_EXECUTE"},
-	{0x4D434257, "MCBW"},
-	{0x4D435357, "MCSW"},
-	{0x4D545844, "MTXD"},
-	{0x4D525844, "MRXD"},
+	{TOPDOG_FW_RESPONSE, "FW_RESPONSE"},
+	{TOPDOG_FW_SET, "FW_SET"},
+	{TOPDOG_FW_SET_AND_EXECUTE, "FW_SET_AND_EXECUTE"},
+	{TOPDOG_PDU_MCBW, "MCBW"},
+	{TOPDOG_PDU_MCSW, "MCSW"},
+	{TOPDOG_PDU_MTXD, "MTXD"},
+	{TOPDOG_PDU_MRXD, "MRXD"},
 	{0, NULL}
 };
 
@@ -241,6 +549,25 @@ static const value_string cmd_types[] = {
 	{0, NULL}
 };
 
+/* MWL8K_STA_ACTION_* */
+static const value_string new_stn_actions[] = {
+	{0, "Add"},
+	{2, "Remove"},
+	{0, NULL}
+};
+
+/* MWL8K_BA_* */
+#define TOPDOG_BA_DESTROY 2
+
+static const value_string bastream_actions[] = {
+	{0, "Create"},
+	{1, "Update"},
+	{TOPDOG_BA_DESTROY, "Destroy"},
+	{3, "Flush"},
+	{4, "Check"},
+	{0, NULL}
+};
+
 static const value_string bandwidth_types[] = {
 	{0, "20 MHz"},
 	{1, "40 MHz"},
@@ -281,6 +608,9 @@ static const value_string rxpd_ctrl_error_types[] = {
 	{0, NULL}
 };
 
+static void format_cmd(gchar *result, guint32 cmd);
+static void format_phy_rate(gchar *result, guint32 kbps);
+
 static hf_register_info hf[] = {
 	{
 		&hf_pdu_type,
@@ -345,6 +675,78 @@ static hf_register_info hf[] = {
 			NULL, HFILL
 		}
 	},
+	{
+		&hf_fw_header_checksum_status,
+		{
+			"Header Checksum Status", "topdog.fw_header_checksum.status",
+			FT_UINT8, BASE_NONE,
+			VALS(proto_checksum_vals), 0x0,
+			NULL, HFILL
+		}
+	},
+	{
+		&hf_fw_data_checksum_status,
+		{
+			"Data Checksum Status", "topdog.fw_data_checksum.status",
+			FT_UINT8, BASE_NONE,
+			VALS(proto_checksum_vals), 0x0,
+			NULL, HFILL
+		}
+	},
+	{
+		&hf_fw_response_in,
+		{
+			"Response In", "topdog.fw_response_in",
+			FT_FRAMENUM, BASE_NONE,
+			NULL, 0x0,
+			"The FW_RESPONSE to this chunk is in this frame", HFILL
+		}
+	},
+	{
+		&hf_fw_request_in,
+		{
+			"Request In", "topdog.fw_request_in",
+			FT_FRAMENUM, BASE_NONE,
+			NULL, 0x0,
+			"This is a response to the firmware chunk in this frame", HFILL
+		}
+	},
+	{
+		&hf_fw_time,
+		{
+			"Time", "topdog.fw_time",
+			FT_RELATIVE_TIME, BASE_NONE,
+			NULL, 0x0,
+			"Time between the firmware chunk and its response", HFILL
+		}
+	},
+	{
+		&hf_response_in,
+		{
+			"Response In", "topdog.response_in",
+			FT_FRAMENUM, BASE_NONE,
+			NULL, 0x0,
+			"The MCSW for this command is in this frame", HFILL
+		}
+	},
+	{
+		&hf_request_in,
+		{
+			"Request In", "topdog.request_in",
+			FT_FRAMENUM, BASE_NONE,
+			NULL, 0x0,
+			"This is a response to the MCBW in this frame", HFILL
+		}
+	},
+	{
+		&hf_time,
+		{
+			"Time", "topdog.time",
+			FT_RELATIVE_TIME, BASE_NONE,
+			NULL, 0x0,
+			"Time between the command and its response", HFILL
+		}
+	},
 	{
 		&hf_tag,
 		{
@@ -403,8 +805,8 @@ static hf_register_info hf[] = {
 		&hf_cmd,
 		{
 			"Command", "topdog.cmd",
-			FT_UINT16, BASE_HEX,
-			VALS(cmd_types), 0x0,
+			FT_UINT16, BASE_CUSTOM,
+			CF_FUNC(format_cmd), 0x0,
 			NULL, HFILL
 		}
 	},
@@ -445,586 +847,4719 @@ static hf_register_info hf[] = {
 		}
 	},
 	{
-		&hf_wcb_ctrl_stat,
+		&hf_cmd_action,
 		{
-			"Control Status", "topdog.wcb_ctrl_stat",
+			"Action", "topdog.cmd.action",
 			FT_UINT16, BASE_HEX,
 			NULL, 0x0,
 			NULL, HFILL
 		}
 	},
 	{
-		&hf_wcb_tx_pri,
+		&hf_hw_spec_hw_rev,
 		{
-			"TX Priority", "topdog.wcb_tx_pri",
+			"Hardware Revision", "topdog.hw_spec.hw_rev",
 			FT_UINT8, BASE_HEX,
 			NULL, 0x0,
 			NULL, HFILL
 		}
 	},
 	{
-		&hf_wcb_tx_frag_count,
+		&hf_hw_spec_host_interface,
 		{
-			"TX Fragment Count", "topdog.wcb_tx_frag_count",
+			"Host Interface", "topdog.hw_spec.host_interface",
 			FT_UINT8, BASE_HEX,
 			NULL, 0x0,
 			NULL, HFILL
 		}
 	},
 	{
-		&hf_wcb_qos_ctrl,
+		&hf_hw_spec_num_mcaddrs,
 		{
-			"QoS Control", "topdog.wcb_qos_ctrl",
-			FT_UINT16, BASE_HEX,
+			"Multicast Addresses", "topdog.hw_spec.num_mcaddrs",
+			FT_UINT16, BASE_DEC,
 			NULL, 0x0,
 			NULL, HFILL
 		}
 	},
 	{
-		&hf_wcb_pkt_ptr,
+		&hf_hw_spec_perm_addr,
 		{
-			"Packet Pointer", "topdog.wcb_pkt_ptr",
-			FT_UINT32, BASE_HEX,
+			"Permanent Address", "topdog.hw_spec.perm_addr",
+			FT_ETHER, BASE_NONE,
 			NULL, 0x0,
 			NULL, HFILL
 		}
 	},
 	{
-		&hf_wcb_pkt_len,
+		&hf_hw_spec_region_code,
 		{
-			"Packet Length", "topdog.wcb_pkt_len",
+			"Region Code", "topdog.hw_spec.region_code",
 			FT_UINT16, BASE_HEX,
 			NULL, 0x0,
 			NULL, HFILL
 		}
 	},
 	{
-		&hf_wcb_dest_mac,
+		&hf_hw_spec_fw_rev,
 		{
-			"Dest MAC Address", "topdog.wcb_dest_mac",
-			FT_ETHER, BASE_NONE,
+			"Firmware Revision", "topdog.hw_spec.fw_rev",
+			FT_UINT32, BASE_HEX,
 			NULL, 0x0,
 			NULL, HFILL
 		}
 	},
 	{
-		&hf_wcb_next_ptr,
+		&hf_hw_spec_ps_cookie,
 		{
-			"Next WCB Pointer", "topdog.wcb_next_ptr",
+			"PS Cookie", "topdog.hw_spec.ps_cookie",
 			FT_UINT32, BASE_HEX,
 			NULL, 0x0,
 			NULL, HFILL
 		}
 	},
 	{
-		&hf_wcb_rate_info,
+		&hf_hw_spec_caps,
 		{
-			"Rate Info", "topdog.wcb_rate_info",
-			FT_UINT16, BASE_HEX,
+			"Capabilities", "topdog.hw_spec.caps",
+			FT_UINT32, BASE_HEX,
 			NULL, 0x0,
 			NULL, HFILL
 		}
 	},
 	{
-		&hf_wcb_reserved,
+		&hf_hw_spec_mcs_bitmap,
 		{
-			"Reserved", "topdog.wcb_reserved",
+			"MCS Bitmap", "topdog.hw_spec.mcs_bitmap",
+			FT_BYTES, BASE_NONE,
+			NULL, 0x0,
+			NULL, HFILL
+		}
+	},
+	{
+		&hf_hw_spec_rx_queue_ptr,
+		{
+			"RX Queue Pointer", "topdog.hw_spec.rx_queue_ptr",
 			FT_UINT32, BASE_HEX,
 			NULL, 0x0,
 			NULL, HFILL
 		}
 	},
 	{
-		&hf_rxpd_rx_ctrl,
+		&hf_hw_spec_num_tx_queues,
 		{
-			"RX Control", "topdog.rxpd_rx_ctrl",
-			FT_UINT8, BASE_HEX,
+			"TX Queues", "topdog.hw_spec.num_tx_queues",
+			FT_UINT32, BASE_DEC,
 			NULL, 0x0,
 			NULL, HFILL
 		}
 	},
 	{
-		&hf_rxpd_rssi,
+		&hf_hw_spec_tx_queue_ptr,
 		{
-			"RSSI", "topdog.rxpd_rssi",
-			FT_UINT8, BASE_HEX,
+			"TX Queue Pointer", "topdog.hw_spec.tx_queue_ptr",
+			FT_UINT32, BASE_HEX,
 			NULL, 0x0,
 			NULL, HFILL
 		}
 	},
 	{
-		&hf_rxpd_channel,
+		&hf_hw_spec_caps2,
 		{
-			"Channel", "topdog.rxpd_channel",
-			FT_UINT8, BASE_HEX,
+			"Capabilities 2", "topdog.hw_spec.caps2",
+			FT_UINT32, BASE_HEX,
 			NULL, 0x0,
 			NULL, HFILL
 		}
 	},
 	{
-		&hf_rxpd_noise_lvl,
+		&hf_hw_spec_num_tx_desc_per_queue,
 		{
-			"Noise Level", "topdog.rxpd_noise_lvl",
-			FT_UINT8, BASE_HEX,
+			"TX Descriptors per Queue", "topdog.hw_spec.num_tx_desc_per_queue",
+			FT_UINT32, BASE_DEC,
 			NULL, 0x0,
 			NULL, HFILL
 		}
 	},
 	{
-		&hf_rxpd_pkt_len,
+		&hf_hw_spec_total_rxd,
 		{
-			"Packet Length", "topdog.pkt_len",
-			FT_UINT16, BASE_HEX,
+			"Total RX Descriptors", "topdog.hw_spec.total_rxd",
+			FT_UINT32, BASE_DEC,
 			NULL, 0x0,
 			NULL, HFILL
 		}
 	},
 	{
-		&hf_rxpd_next_ptr,
+		&hf_rf_channel_channel,
 		{
-			"Next RxPD Pointer", "topdog.next_rxpd_ptr",
-			FT_UINT16, BASE_HEX,
+			"Channel", "topdog.rf_channel.channel",
+			FT_UINT8, BASE_DEC,
 			NULL, 0x0,
 			NULL, HFILL
 		}
 	},
 	{
-		&hf_rxpd_qos_ctrl,
+		&hf_rf_channel_flags,
 		{
-			"QoS Control", "topdog.qos_ctrl",
-			FT_UINT16, BASE_HEX,
+			"Channel Flags", "topdog.rf_channel.flags",
+			FT_UINT32, BASE_HEX,
 			NULL, 0x0,
 			NULL, HFILL
 		}
 	},
 	{
-		&hf_rxpd_rxpd_ctrl,
+		&hf_edca_txop,
 		{
-			"RxPD Control", "topdog.rxpd_rxpd_ctrl",
-			FT_UINT16, BASE_HEX,
+			"TXOP Limit (32 us)", "topdog.edca.txop",
+			FT_UINT16, BASE_DEC,
 			NULL, 0x0,
 			NULL, HFILL
 		}
 	},
 	{
-		&hf_rxpd_rx_rate_info,
+		&hf_edca_log_cw_max,
 		{
-			"RX Rate Info", "topdog.rxpd_rx_rate_info",
-			FT_UINT16, BASE_HEX,
+			"Log2 CWmax", "topdog.edca.log_cw_max",
+			FT_UINT32, BASE_DEC,
 			NULL, 0x0,
 			NULL, HFILL
 		}
 	},
 	{
-		&hf_rxpd_tx_rate_info,
+		&hf_edca_log_cw_min,
 		{
-			"TX Rate Info", "topdog.rxpd_tx_rate_info",
-			FT_UINT16, BASE_HEX,
+			"Log2 CWmin", "topdog.edca.log_cw_min",
+			FT_UINT32, BASE_DEC,
 			NULL, 0x0,
 			NULL, HFILL
 		}
 	},
 	{
-		&hf_qos_ctrl_tid,
+		&hf_edca_aifs,
 		{
-			"TID", "topdog.qos_ctrl.tid",
-			FT_UINT16, BASE_HEX,
-			NULL, 0x000f,
+			"AIFS", "topdog.edca.aifs",
+			FT_UINT8, BASE_DEC,
+			NULL, 0x0,
 			NULL, HFILL
 		}
 	},
 	{
-		&hf_qos_ctrl_eos,
+		&hf_edca_txq,
 		{
-			"EOS", "topdog.qos_ctrl.eos",
-			FT_BOOLEAN, 16,
-			NULL, 0x0010,
+			"TX Queue", "topdog.edca.txq",
+			FT_UINT8, BASE_DEC,
+			NULL, 0x0,
 			NULL, HFILL
 		}
 	},
 	{
-		&hf_qos_ctrl_ack_policy,
+		&hf_set_rate_legacy_rates,
 		{
-			"ACK Policy", "topdog.qos_ctrl.ack_policy",
-			FT_UINT16, BASE_HEX,
-			NULL, 0x0060,
+			"Legacy Rates", "topdog.set_rate.legacy_rates",
+			FT_BYTES, BASE_NONE,
+			NULL, 0x0,
 			NULL, HFILL
 		}
 	},
 	{
-		&hf_qos_ctrl_amsdu_present,
+		&hf_set_rate_mcs_set,
 		{
-			"AMSDU Present", "topdog.qos_ctrl.amsdu_present",
-			FT_BOOLEAN, 16,
-			NULL, 0x0080,
+			"MCS Set", "topdog.set_rate.mcs_set",
+			FT_BYTES, BASE_NONE,
+			NULL, 0x0,
 			NULL, HFILL
 		}
 	},
 	{
-		&hf_qos_ctrl_queue_size,
+		&hf_new_stn_aid,
 		{
-			"Queue Size", "topdog.qos_ctrl.queue_size",
-			FT_UINT16, BASE_HEX,
-			NULL, 0xff00,
+			"AID", "topdog.new_stn.aid",
+			FT_UINT16, BASE_DEC,
+			NULL, 0x0,
 			NULL, HFILL
 		}
 	},
 	{
-		&hf_rate_info_ht_mode,
+		&hf_new_stn_mac_addr,
 		{
-			"High-Throughput Mode", "topdog.rate_info.ht_mode",
-			FT_BOOLEAN, 16,
-			NULL, 0x0001,
+			"MAC Address", "topdog.new_stn.mac_addr",
+			FT_ETHER, BASE_NONE,
+			NULL, 0x0,
 			NULL, HFILL
 		}
 	},
 	{
-		&hf_rate_info_short_gi,
+		&hf_new_stn_stn_id,
 		{
-			"Short Guard Interval", "topdog.rate_info.short_gi",
-			FT_BOOLEAN, 16,
-			NULL, 0x0002,
+			"Station ID", "topdog.new_stn.stn_id",
+			FT_UINT16, BASE_DEC,
+			NULL, 0x0,
 			NULL, HFILL
 		}
 	},
 	{
-		&hf_rate_info_bandwidth,
+		&hf_new_stn_action,
 		{
-			"Bandwidth", "topdog.rate_info.bandwidth",
+			"Action", "topdog.new_stn.action",
 			FT_UINT16, BASE_HEX,
-			VALS(bandwidth_types), 0x0004,
+			VALS(new_stn_actions), 0x0,
 			NULL, HFILL
 		}
 	},
 	{
-		&hf_rate_info_mcs,
+		&hf_new_stn_legacy_rates,
 		{
-			"MCS Index", "topdog.rate_info.mcs",
-			FT_UINT16, BASE_HEX,
-			NULL, 0x01f8,
+			"Legacy Rates", "topdog.new_stn.legacy_rates",
+			FT_UINT32, BASE_HEX,
+			NULL, 0x0,
 			NULL, HFILL
 		}
 	},
 	{
-		&hf_rate_info_adv_coding,
+		&hf_new_stn_ht_rates,
 		{
-			"Advanced Coding", "topdog.rate_info.adv_coding",
-			FT_UINT16, BASE_HEX,
-			VALS(adv_coding_types), 0x0600,
+			"HT Rates", "topdog.new_stn.ht_rates",
+			FT_BYTES, BASE_NONE,
+			NULL, 0x0,
 			NULL, HFILL
 		}
 	},
 	{
-		&hf_rate_info_ant_select,
+		&hf_new_stn_cap_info,
 		{
-			"Antenna Select", "topdog.rate_info.ant_select",
+			"Capability Info", "topdog.new_stn.cap_info",
 			FT_UINT16, BASE_HEX,
-			VALS(ant_select_types), 0x1800,
+			NULL, 0x0,
 			NULL, HFILL
 		}
 	},
 	{
-		&hf_rate_info_active_subchannels,
+		&hf_new_stn_ht_cap_info,
 		{
-			"Active Subchannels", "topdog.rate_info.active_subchannels",
+			"HT Capabilities Info", "topdog.new_stn.ht_cap_info",
 			FT_UINT16, BASE_HEX,
-			VALS(active_subchannels_types), 0x6000,
+			NULL, 0x0,
 			NULL, HFILL
 		}
 	},
 	{
-		&hf_rate_info_short_preamble,
+		&hf_new_stn_mac_ht_param_info,
 		{
-			"Short Preamble", "topdog.rate_info.short_preamble",
-			FT_BOOLEAN, 16,
-			NULL, 0x8000,
+			"MAC HT Parameters", "topdog.new_stn.mac_ht_param_info",
+			FT_UINT8, BASE_HEX,
+			NULL, 0x0,
 			NULL, HFILL
 		}
 	},
 	{
-		&hf_rxpd_ctrl_is_ampdu,
+		&hf_new_stn_control_channel,
 		{
-			"Is AMPDU Packet", "topdog.rxpd_ctrl.is_ampdu",
-			FT_BOOLEAN, 16,
-			NULL, 0x0001,
+			"Control Channel", "topdog.new_stn.control_channel",
+			FT_UINT8, BASE_DEC,
+			NULL, 0x0,
 			NULL, HFILL
 		}
 	},
 	{
-		&hf_rxpd_ctrl_owner,
+		&hf_new_stn_add_channel,
 		{
-			"Owner", "topdog.rxpd_ctrl.owner",
-			FT_UINT16, BASE_HEX,
-			VALS(rxpd_ctrl_owner_types), 0x0002,
+			"Secondary Channel", "topdog.new_stn.add_channel",
+			FT_UINT8, BASE_DEC,
+			NULL, 0x0,
 			NULL, HFILL
 		}
 	},
 	{
-		&hf_rxpd_ctrl_decrypt_error,
+		&hf_new_stn_op_mode,
 		{
-			"Decryption Error", "topdog.rxpd_ctrl.decrypt_error",
-			FT_BOOLEAN, 16,
-			NULL, 0x0004,
+			"Operating Mode", "topdog.new_stn.op_mode",
+			FT_UINT16, BASE_HEX,
+			NULL, 0x0,
 			NULL, HFILL
 		}
 	},
 	{
-		&hf_rxpd_ctrl_error_type,
+		&hf_new_stn_stbc,
 		{
-			"Error Type", "topdog.rxpd_ctrl.error_type",
+			"STBC", "topdog.new_stn.stbc",
 			FT_UINT16, BASE_HEX,
-			VALS(rxpd_ctrl_error_types), 0x0008,
+			NULL, 0x0,
 			NULL, HFILL
 		}
 	},
 	{
-		&hf_rxpd_ctrl_key_index,
+		&hf_new_stn_is_qos_sta,
 		{
-			"Key Index", "topdog.rxpd_ctrl.key_index",
-			FT_UINT16, BASE_HEX,
-			NULL, 0x0030,
+			"QoS Station", "topdog.new_stn.is_qos_sta",
+			FT_UINT8, BASE_DEC,
+			NULL, 0x0,
 			NULL, HFILL
 		}
 	},
 	{
-		&hf_rxpd_ctrl_reserved,
+		&hf_new_stn_fw_sta_ptr,
 		{
-			"Reserved", "topdog.rxpd_ctrl.reserved",
-			FT_UINT16, BASE_HEX,
-			NULL, 0xffc0,
+			"Firmware Station Pointer", "topdog.new_stn.fw_sta_ptr",
+			FT_UINT32, BASE_HEX,
+			NULL, 0x0,
 			NULL, HFILL
 		}
 	},
 	{
-		&hf_wlan_pkt,
+		&hf_bastream_action,
 		{
-			"802.11 packet data", "topdog.wlan_pkt",
-			FT_BYTES, BASE_NONE,
+			"Action", "topdog.bastream.action",
+			FT_UINT32, BASE_HEX,
+			VALS(bastream_actions), 0x0,
+			NULL, HFILL
+		}
+	},
+	{
+		&hf_bastream_flags,
+		{
+			"Flags", "topdog.bastream.flags",
+			FT_UINT32, BASE_HEX,
 			NULL, 0x0,
 			NULL, HFILL
 		}
-	}
-};
-
-static const int *qos_ctrl_flags[] = {
-	&hf_qos_ctrl_tid,
-	&hf_qos_ctrl_eos,
+	},
+	{
+		&hf_bastream_idle_thrs,
+		{
+			"Idle Threshold", "topdog.bastream.idle_thrs",
+			FT_UINT32, BASE_DEC,
+			NULL, 0x0,
+			NULL, HFILL
+		}
+	},
+	{
+		&hf_bastream_bar_thrs,
+		{
+			"BAR Threshold", "topdog.bastream.bar_thrs",
+			FT_UINT32, BASE_DEC,
+			NULL, 0x0,
+			NULL, HFILL
+		}
+	},
+	{
+		&hf_bastream_window_size,
+		{
+			"Window Size", "topdog.bastream.window_size",
+			FT_UINT32, BASE_DEC,
+			NULL, 0x0,
+			NULL, HFILL
+		}
+	},
+	{
+		&hf_bastream_peer_mac_addr,
+		{
+			"Peer MAC Address", "topdog.bastream.peer_mac_addr",
+			FT_ETHER, BASE_NONE,
+			NULL, 0x0,
+			NULL, HFILL
+		}
+	},
+	{
+		&hf_bastream_dialog_token,
+		{
+			"Dialog Token", "topdog.bastream.dialog_token",
+			FT_UINT8, BASE_DEC,
+			NULL, 0x0,
+			NULL, HFILL
+		}
+	},
+	{
+		&hf_bastream_tid,
+		{
+			"TID", "topdog.bastream.tid",
+			FT_UINT8, BASE_DEC,
+			NULL, 0x0,
+			NULL, HFILL
+		}
+	},
+	{
+		&hf_bastream_queue_id,
+		{
+			"Queue ID", "topdog.bastream.queue_id",
+			FT_UINT8, BASE_DEC,
+			NULL, 0x0,
+			NULL, HFILL
+		}
+	},
+	{
+		&hf_bastream_param_info,
+		{
+			"Parameter Info", "topdog.bastream.param_info",
+			FT_UINT8, BASE_HEX,
+			NULL, 0x0,
+			NULL, HFILL
+		}
+	},
+	{
+		&hf_bastream_ba_context,
+		{
+			"BA Context", "topdog.bastream.ba_context",
+			FT_UINT32, BASE_HEX,
+			NULL, 0x0,
+			NULL, HFILL
+		}
+	},
+	{
+		&hf_bastream_curr_seq_no,
+		{
+			"Current Sequence Number", "topdog.bastream.curr_seq_no",
+			FT_UINT16, BASE_DEC,
+			NULL, 0x0,
+			NULL, HFILL
+		}
+	},
+	{
+		&hf_bastream_sta_src_mac_addr,
+		{
+			"Station Source MAC Address", "topdog.bastream.sta_src_mac_addr",
+			FT_ETHER, BASE_NONE,
+			NULL, 0x0,
+			NULL, HFILL
+		}
+	},
+	{
+		&hf_rateadapt_mode,
+		{
+			"Mode", "topdog.rateadapt.mode",
+			FT_UINT16, BASE_HEX,
+			NULL, 0x0,
+			NULL, HFILL
+		}
+	},
+	{
+		&hf_wcb_ctrl_stat,
+		{
+			"Control Status", "topdog.wcb_ctrl_stat",
+			FT_UINT16, BASE_HEX,
+			NULL, 0x0,
+			NULL, HFILL
+		}
+	},
+	{
+		&hf_wcb_tx_pri,
+		{
+			"TX Priority", "topdog.wcb_tx_pri",
+			FT_UINT8, BASE_HEX,
+			NULL, 0x0,
+			NULL, HFILL
+		}
+	},
+	{
+		&hf_wcb_tx_frag_count,
+		{
+			"TX Fragment Count", "topdog.wcb_tx_frag_count",
+			FT_UINT8, BASE_HEX,
+			NULL, 0x0,
+			NULL, HFILL
+		}
+	},
+	{
+		&hf_wcb_qos_ctrl,
+		{
+			"QoS Control", "topdog.wcb_qos_ctrl",
+			FT_UINT16, BASE_HEX,
+			NULL, 0x0,
+			NULL, HFILL
+		}
+	},
+	{
+		&hf_wcb_pkt_ptr,
+		{
+			"Packet Pointer", "topdog.wcb_pkt_ptr",
+			FT_UINT32, BASE_HEX,
+			NULL, 0x0,
+			NULL, HFILL
+		}
+	},
+	{
+		&hf_wcb_pkt_len,
+		{
+			"Packet Length", "topdog.wcb_pkt_len",
+			FT_UINT16, BASE_HEX,
+			NULL, 0x0,
+			NULL, HFILL
+		}
+	},
+	{
+		&hf_wcb_dest_mac,
+		{
+			"Dest MAC Address", "topdog.wcb_dest_mac",
+			FT_ETHER, BASE_NONE,
+			NULL, 0x0,
+			NULL, HFILL
+		}
+	},
+	{
+		&hf_wcb_next_ptr,
+		{
+			"Next WCB Pointer", "topdog.wcb_next_ptr",
+			FT_UINT32, BASE_HEX,
+			NULL, 0x0,
+			NULL, HFILL
+		}
+	},
+	{
+		&hf_wcb_rate_info,
+		{
+			"Rate Info", "topdog.wcb_rate_info",
+			FT_UINT16, BASE_HEX,
+			NULL, 0x0,
+			NULL, HFILL
+		}
+	},
+	{
+		&hf_wcb_phy_rate,
+		{
+			"PHY Rate", "topdog.wcb_phy_rate",
+			FT_UINT32, BASE_CUSTOM,
+			CF_FUNC(format_phy_rate), 0x0,
+			"Data rate in kbps derived from the rate info", HFILL
+		}
+	},
+	{
+		&hf_wcb_airtime,
+		{
+			"Estimated Airtime (us)", "topdog.wcb_airtime",
+			FT_UINT32, BASE_DEC,
+			NULL, 0x0,
+			"PLCP preamble plus payload at the PHY rate; excludes contention and ACK", HFILL
+		}
+	},
+	{
+		&hf_wcb_reserved,
+		{
+			"Reserved", "topdog.wcb_reserved",
+			FT_UINT32, BASE_HEX,
+			NULL, 0x0,
+			NULL, HFILL
+		}
+	},
+	{
+		&hf_rxpd_rx_ctrl,
+		{
+			"RX Control", "topdog.rxpd_rx_ctrl",
+			FT_UINT8, BASE_HEX,
+			NULL, 0x0,
+			NULL, HFILL
+		}
+	},
+	{
+		&hf_rxpd_rssi,
+		{
+			"RSSI", "topdog.rxpd_rssi",
+			FT_UINT8, BASE_HEX,
+			NULL, 0x0,
+			NULL, HFILL
+		}
+	},
+	{
+		&hf_rxpd_channel,
+		{
+			"Channel", "topdog.rxpd_channel",
+			FT_UINT8, BASE_HEX,
+			NULL, 0x0,
+			NULL, HFILL
+		}
+	},
+	{
+		&hf_rxpd_noise_lvl,
+		{
+			"Noise Level", "topdog.rxpd_noise_lvl",
+			FT_UINT8, BASE_HEX,
+			NULL, 0x0,
+			NULL, HFILL
+		}
+	},
+	{
+		&hf_rxpd_pkt_len,
+		{
+			"Packet Length", "topdog.pkt_len",
+			FT_UINT16, BASE_HEX,
+			NULL, 0x0,
+			NULL, HFILL
+		}
+	},
+	{
+		&hf_rxpd_next_ptr,
+		{
+			"Next RxPD Pointer", "topdog.next_rxpd_ptr",
+			FT_UINT16, BASE_HEX,
+			NULL, 0x0,
+			NULL, HFILL
+		}
+	},
+	{
+		&hf_rxpd_qos_ctrl,
+		{
+			"QoS Control", "topdog.qos_ctrl",
+			FT_UINT16, BASE_HEX,
+			NULL, 0x0,
+			NULL, HFILL
+		}
+	},
+	{
+		&hf_rxpd_rxpd_ctrl,
+		{
+			"RxPD Control", "topdog.rxpd_rxpd_ctrl",
+			FT_UINT16, BASE_HEX,
+			NULL, 0x0,
+			NULL, HFILL
+		}
+	},
+	{
+		&hf_rxpd_rx_rate_info,
+		{
+			"RX Rate Info", "topdog.rxpd_rx_rate_info",
+			FT_UINT16, BASE_HEX,
+			NULL, 0x0,
+			NULL, HFILL
+		}
+	},
+	{
+		&hf_rxpd_tx_rate_info,
+		{
+			"TX Rate Info", "topdog.rxpd_tx_rate_info",
+			FT_UINT16, BASE_HEX,
+			NULL, 0x0,
+			NULL, HFILL
+		}
+	},
+	{
+		&hf_rxpd_rx_phy_rate,
+		{
+			"RX PHY Rate", "topdog.rxpd_rx_phy_rate",
+			FT_UINT32, BASE_CUSTOM,
+			CF_FUNC(format_phy_rate), 0x0,
+			"Data rate in kbps derived from the RX rate info", HFILL
+		}
+	},
+	{
+		&hf_rxpd_tx_phy_rate,
+		{
+			"TX PHY Rate", "topdog.rxpd_tx_phy_rate",
+			FT_UINT32, BASE_CUSTOM,
+			CF_FUNC(format_phy_rate), 0x0,
+			"Data rate in kbps derived from the TX rate info", HFILL
+		}
+	},
+	{
+		&hf_rxpd_airtime,
+		{
+			"Estimated Airtime (us)", "topdog.rxpd_airtime",
+			FT_UINT32, BASE_DEC,
+			NULL, 0x0,
+			"PLCP preamble plus payload at the RX PHY rate", HFILL
+		}
+	},
+	{
+		&hf_qos_ctrl_tid,
+		{
+			"TID", "topdog.qos_ctrl.tid",
+			FT_UINT16, BASE_HEX,
+			NULL, 0x000f,
+			NULL, HFILL
+		}
+	},
+	{
+		&hf_qos_ctrl_eos,
+		{
+			"EOS", "topdog.qos_ctrl.eos",
+			FT_BOOLEAN, 16,
+			NULL, 0x0010,
+			NULL, HFILL
+		}
+	},
+	{
+		&hf_qos_ctrl_ack_policy,
+		{
+			"ACK Policy", "topdog.qos_ctrl.ack_policy",
+			FT_UINT16, BASE_HEX,
+			NULL, 0x0060,
+			NULL, HFILL
+		}
+	},
+	{
+		&hf_qos_ctrl_amsdu_present,
+		{
+			"AMSDU Present", "topdog.qos_ctrl.amsdu_present",
+			FT_BOOLEAN, 16,
+			NULL, 0x0080,
+			NULL, HFILL
+		}
+	},
+	{
+		&hf_qos_ctrl_queue_size,
+		{
+			"Queue Size", "topdog.qos_ctrl.queue_size",
+			FT_UINT16, BASE_HEX,
+			NULL, 0xff00,
+			NULL, HFILL
+		}
+	},
+	{
+		&hf_rate_info_ht_mode,
+		{
+			"High-Throughput Mode", "topdog.rate_info.ht_mode",
+			FT_BOOLEAN, 16,
+			NULL, 0x0001,
+			NULL, HFILL
+		}
+	},
+	{
+		&hf_rate_info_short_gi,
+		{
+			"Short Guard Interval", "topdog.rate_info.short_gi",
+			FT_BOOLEAN, 16,
+			NULL, 0x0002,
+			NULL, HFILL
+		}
+	},
+	{
+		&hf_rate_info_bandwidth,
+		{
+			"Bandwidth", "topdog.rate_info.bandwidth",
+			FT_UINT16, BASE_HEX,
+			VALS(bandwidth_types), 0x0004,
+			NULL, HFILL
+		}
+	},
+	{
+		&hf_rate_info_mcs,
+		{
+			"MCS Index", "topdog.rate_info.mcs",
+			FT_UINT16, BASE_HEX,
+			NULL, 0x01f8,
+			NULL, HFILL
+		}
+	},
+	{
+		&hf_rate_info_adv_coding,
+		{
+			"Advanced Coding", "topdog.rate_info.adv_coding",
+			FT_UINT16, BASE_HEX,
+			VALS(adv_coding_types), 0x0600,
+			NULL, HFILL
+		}
+	},
+	{
+		&hf_rate_info_ant_select,
+		{
+			"Antenna Select", "topdog.rate_info.ant_select",
+			FT_UINT16, BASE_HEX,
+			VALS(ant_select_types), 0x1800,
+			NULL, HFILL
+		}
+	},
+	{
+		&hf_rate_info_active_subchannels,
+		{
+			"Active Subchannels", "topdog.rate_info.active_subchannels",
+			FT_UINT16, BASE_HEX,
+			VALS(active_subchannels_types), 0x6000,
+			NULL, HFILL
+		}
+	},
+	{
+		&hf_rate_info_short_preamble,
+		{
+			"Short Preamble", "topdog.rate_info.short_preamble",
+			FT_BOOLEAN, 16,
+			NULL, 0x8000,
+			NULL, HFILL
+		}
+	},
+	{
+		&hf_rxpd_ctrl_is_ampdu,
+		{
+			"Is AMPDU Packet", "topdog.rxpd_ctrl.is_ampdu",
+			FT_BOOLEAN, 16,
+			NULL, 0x0001,
+			NULL, HFILL
+		}
+	},
+	{
+		&hf_rxpd_ctrl_owner,
+		{
+			"Owner", "topdog.rxpd_ctrl.owner",
+			FT_UINT16, BASE_HEX,
+			VALS(rxpd_ctrl_owner_types), 0x0002,
+			NULL, HFILL
+		}
+	},
+	{
+		&hf_rxpd_ctrl_decrypt_error,
+		{
+			"Decryption Error", "topdog.rxpd_ctrl.decrypt_error",
+			FT_BOOLEAN, 16,
+			NULL, 0x0004,
+			NULL, HFILL
+		}
+	},
+	{
+		&hf_rxpd_ctrl_error_type,
+		{
+			"Error Type", "topdog.rxpd_ctrl.error_type",
+			FT_UINT16, BASE_HEX,
+			VALS(rxpd_ctrl_error_types), 0x0008,
+			NULL, HFILL
+		}
+	},
+	{
+		&hf_rxpd_ctrl_key_index,
+		{
+			"Key Index", "topdog.rxpd_ctrl.key_index",
+			FT_UINT16, BASE_HEX,
+			NULL, 0x0030,
+			NULL, HFILL
+		}
+	},
+	{
+		&hf_rxpd_ctrl_reserved,
+		{
+			"Reserved", "topdog.rxpd_ctrl.reserved",
+			FT_UINT16, BASE_HEX,
+			NULL, 0xffc0,
+			NULL, HFILL
+		}
+	},
+	{
+		&hf_wlan_pkt,
+		{
+			"802.11 packet data", "topdog.wlan_pkt",
+			FT_BYTES, BASE_NONE,
+			NULL, 0x0,
+			NULL, HFILL
+		}
+	},
+	{
+		&hf_chain_len,
+		{
+			"Descriptors in Transfer", "topdog.chain_len",
+			FT_UINT32, BASE_DEC,
+			NULL, 0x0,
+			NULL, HFILL
+		}
+	},
+	{
+		&hf_urb_len,
+		{
+			"Transfer Length", "topdog.urb_len",
+			FT_UINT32, BASE_DEC,
+			NULL, 0x0,
+			"Length of the bulk transfer", HFILL
+		}
+	},
+	{
+		&hf_urb_payload_len,
+		{
+			"Payload Bytes", "topdog.urb_payload_len",
+			FT_UINT32, BASE_DEC,
+			NULL, 0x0,
+			"802.11 bytes carried by the descriptors in this transfer", HFILL
+		}
+	},
+	{
+		&hf_urb_header_len,
+		{
+			"Descriptor Header Bytes", "topdog.urb_header_len",
+			FT_UINT32, BASE_DEC,
+			NULL, 0x0,
+			NULL, HFILL
+		}
+	},
+	{
+		&hf_urb_padding,
+		{
+			"Padding Bytes", "topdog.urb_padding",
+			FT_UINT32, BASE_DEC,
+			NULL, 0x0,
+			"Transfer bytes not covered by a descriptor header or payload", HFILL
+		}
+	},
+	{
+		&hf_wcb_ring_occupancy,
+		{
+			"TX Ring Occupancy", "topdog.wcb_ring_occupancy",
+			FT_UINT32, BASE_DEC,
+			NULL, 0x0,
+			"Descriptors of this TX priority held by the device after this one", HFILL
+		}
+	},
+	{
+		&hf_wcb_ring_high_water,
+		{
+			"TX Ring High-Water Mark", "topdog.wcb_ring_high_water",
+			FT_UINT32, BASE_DEC,
+			NULL, 0x0,
+			"Highest occupancy of this TX priority's ring so far", HFILL
+		}
+	},
+	{
+		&hf_wcb_ring_size,
+		{
+			"TX Ring Size", "topdog.wcb_ring_size",
+			FT_UINT32, BASE_DEC,
+			NULL, 0x0,
+			NULL, HFILL
+		}
+	},
+	{
+		&hf_reassembled_in,
+		{
+			"Reassembled In", "topdog.reassembled_in",
+			FT_FRAMENUM, BASE_NONE,
+			NULL, 0x0,
+			"The PDU this transfer belongs to is completed in this frame", HFILL
+		}
+	},
+	{
+		&hf_fragment_first,
+		{
+			"First Fragment In", "topdog.fragment_first",
+			FT_FRAMENUM, BASE_NONE,
+			NULL, 0x0,
+			"This PDU starts in this frame", HFILL
+		}
+	},
+	{
+		&hf_fragment_count,
+		{
+			"Fragments", "topdog.fragment_count",
+			FT_UINT32, BASE_DEC,
+			NULL, 0x0,
+			"Bulk transfers this PDU was reassembled from", HFILL
+		}
+	},
+	{
+		&hf_reassembled_len,
+		{
+			"Reassembled Length", "topdog.reassembled_len",
+			FT_UINT32, BASE_DEC,
+			NULL, 0x0,
+			NULL, HFILL
+		}
+	}
+};
+
+static const int *qos_ctrl_flags[] = {
+	&hf_qos_ctrl_tid,
+	&hf_qos_ctrl_eos,
 	&hf_qos_ctrl_ack_policy,
 	&hf_qos_ctrl_amsdu_present,
 	&hf_qos_ctrl_queue_size,
 	NULL
 };
 
-static const int *rate_info_flags[] = {
-	&hf_rate_info_ht_mode,
-	&hf_rate_info_short_gi,
-	&hf_rate_info_bandwidth,
-	&hf_rate_info_mcs,
-	&hf_rate_info_adv_coding,
-	&hf_rate_info_ant_select,
-	&hf_rate_info_active_subchannels,
-	&hf_rate_info_short_preamble,
-	NULL
-};
+static const int *rate_info_flags[] = {
+	&hf_rate_info_ht_mode,
+	&hf_rate_info_short_gi,
+	&hf_rate_info_bandwidth,
+	&hf_rate_info_mcs,
+	&hf_rate_info_adv_coding,
+	&hf_rate_info_ant_select,
+	&hf_rate_info_active_subchannels,
+	&hf_rate_info_short_preamble,
+	NULL
+};
+
+static const int *rxpd_ctrl_flags[] = {
+	&hf_rxpd_ctrl_is_ampdu,
+	&hf_rxpd_ctrl_owner,
+	&hf_rxpd_ctrl_decrypt_error,
+	&hf_rxpd_ctrl_error_type,
+	&hf_rxpd_ctrl_key_index,
+	&hf_rxpd_ctrl_reserved,
+	NULL
+};
+
+static gint *ett_list[] = {
+	&ett_topdog,
+	&ett_qos_ctrl,
+	&ett_rate_info,
+	&ett_rxpd_ctrl,
+	&ett_cmd_body
+};
+
+static ei_register_info ei[] = {
+	{
+		&ei_chain_bad_next_ptr,
+		{
+			"topdog.chain.bad_next_ptr", PI_MALFORMED, PI_ERROR,
+			"Next descriptor pointer does not advance", EXPFILL
+		}
+	},
+	{
+		&ei_chain_too_long,
+		{
+			"topdog.chain.too_long", PI_MALFORMED, PI_WARN,
+			"Descriptor chain exceeds hop limit", EXPFILL
+		}
+	},
+	{
+		&ei_fw_bad_checksum,
+		{
+			"topdog.fw_bad_checksum", PI_CHECKSUM, PI_ERROR,
+			"Bad firmware checksum", EXPFILL
+		}
+	},
+	{
+		&ei_cmd_no_response,
+		{
+			"topdog.cmd_no_response", PI_SEQUENCE, PI_WARN,
+			"No response seen to this command", EXPFILL
+		}
+	},
+	{
+		&ei_state_evicted,
+		{
+			"topdog.state_evicted", PI_SEQUENCE, PI_NOTE,
+			"Tracking state evicted: state table limit reached", EXPFILL
+		}
+	},
+	{
+		&ei_tx_ring_full,
+		{
+			"topdog.tx_ring_full", PI_SEQUENCE, PI_WARN,
+			"TX ring full: oldest descriptor assumed reclaimed", EXPFILL
+		}
+	},
+	{
+		&ei_truncated,
+		{
+			"topdog.truncated", PI_SEQUENCE, PI_NOTE,
+			"Transfer cut short by the capture length; dissected as far as captured", EXPFILL
+		}
+	}
+};
+
+/* CRC-32 (same as crc32_ccitt) using slicing-by-8: eight table lookups per
+** eight input bytes instead of one per byte. Firmware chunks are large and a
+** boot capture has thousands of them. */
+static guint32 crc32_slice_table[8][256];
+
+static void crc32_slice_init(void)
+{
+	guint32 i, j, crc;
+
+	for (i = 0; i < 256; i++) {
+		crc = i;
+		for (j = 0; j < 8; j++)
+			crc = (crc >> 1) ^ (0xEDB88320 & (0 - (crc & 1)));
+		crc32_slice_table[0][i] = crc;
+	}
+	for (i = 0; i < 256; i++)
+		for (j = 1; j < 8; j++)
+			crc32_slice_table[j][i] = (crc32_slice_table[j-1][i] >> 8)
+				^ crc32_slice_table[0][crc32_slice_table[j-1][i] & 0xff];
+}
+
+static guint32 crc32_slice8(const guint8 *buf, guint len)
+{
+	guint32 crc = 0xffffffff;
+
+	while (len >= 8) {
+		guint32 one = crc ^ ((guint32)buf[0] | (guint32)buf[1] << 8
+			| (guint32)buf[2] << 16 | (guint32)buf[3] << 24);
+		guint32 two = (guint32)buf[4] | (guint32)buf[5] << 8
+			| (guint32)buf[6] << 16 | (guint32)buf[7] << 24;
+
+		crc = crc32_slice_table[7][one & 0xff]
+			^ crc32_slice_table[6][(one >> 8) & 0xff]
+			^ crc32_slice_table[5][(one >> 16) & 0xff]
+			^ crc32_slice_table[4][one >> 24]
+			^ crc32_slice_table[3][two & 0xff]
+			^ crc32_slice_table[2][(two >> 8) & 0xff]
+			^ crc32_slice_table[1][(two >> 16) & 0xff]
+			^ crc32_slice_table[0][two >> 24];
+		buf += 8;
+		len -= 8;
+	}
+	while (len--)
+		crc = (crc >> 8) ^ crc32_slice_table[0][(crc ^ *buf++) & 0xff];
+
+	return ~crc;
+}
+
+/* PHY rate and PLCP preamble for every TOPDOG_RATE_INDEX, computed once at
+** registration. Legacy rates use the MCS field as an index into the driver's
+** rate list (1, 2, 5.5, 11, 22, 6 ... 72 Mbps); HT rates cover MCS 0-32.
+** Unknown combinations have a rate of 0. */
+typedef struct _topdog_phy_rate {
+	guint32 kbps;
+	guint16 preamble_us;
+} topdog_phy_rate;
+
+static topdog_phy_rate phy_rates[512];
+
+static void phy_rate_init(void)
+{
+	static const guint32 legacy_kbps[14] = {
+		1000, 2000, 5500, 11000, 22000, 6000, 9000,
+		12000, 18000, 24000, 36000, 48000, 54000, 72000
+	};
+	static const guint32 ht20_kbps[8] = {
+		6500, 13000, 19500, 26000, 39000, 52000, 58500, 65000
+	};
+	static const guint32 ht40_kbps[8] = {
+		13500, 27000, 40500, 54000, 81000, 108000, 121500, 135000
+	};
+	guint i;
+
+	for (i = 0; i < array_length(phy_rates); i++) {
+		guint mcs = TOPDOG_RATE_MCS(i);
+		guint32 kbps = 0;
+
+		if (!TOPDOG_RATE_HT(i)) {
+			if (mcs < array_length(legacy_kbps)) {
+				kbps = legacy_kbps[mcs];
+				/* DSSS/CCK long preamble, otherwise OFDM */
+				phy_rates[i].preamble_us = mcs < 5 ? 192 : 20;
+			}
+		} else {
+			guint nss = mcs / 8 + 1;
+
+			if (mcs < 32)
+				kbps = nss * (TOPDOG_RATE_BW40(i) ? ht40_kbps[mcs % 8] : ht20_kbps[mcs % 8]);
+			else if (mcs == 32 && TOPDOG_RATE_BW40(i))
+				kbps = 6000;
+			if (TOPDOG_RATE_SHORT_GI(i))
+				kbps = kbps * 10 / 9;
+			/* HT-mixed: legacy training and signal fields, HT-SIG,
+			** HT-STF and one HT-LTF per spatial stream */
+			phy_rates[i].preamble_us = 32 + 4 * (mcs < 32 ? nss : 1);
+		}
+		phy_rates[i].kbps = kbps;
+	}
+}
+
+/* Time on air of one frame: preamble plus payload at the PHY rate. Backoff,
+** SIFS, the ACK and retries are not visible in the descriptor and are left
+** out. Returns 0 if the rate is unknown. */
+static guint32 topdog_airtime_us(guint16 rate_info, guint16 pkt_len)
+{
+	const topdog_phy_rate *rate = &phy_rates[TOPDOG_RATE_INDEX(rate_info)];
+
+	if (rate->kbps == 0)
+		return 0;
+
+	return rate->preamble_us + (pkt_len * 8000 + rate->kbps - 1) / rate->kbps;
+}
+
+static void format_phy_rate(gchar *result, guint32 kbps)
+{
+	g_snprintf(result, ITEM_LABEL_LENGTH, "%u.%u Mbps", kbps / 1000, kbps % 1000 / 100);
+}
+
+static void add_phy_rate(proto_tree *tree, int hf, tvbuff_t *tvb, guint32 offset, guint16 rate_info)
+{
+	guint32 kbps = phy_rates[TOPDOG_RATE_INDEX(rate_info)].kbps;
+	proto_item *item;
+
+	if (kbps == 0)
+		return;
+
+	item = proto_tree_add_uint(tree, hf, tvb, offset, 2, kbps);
+	PROTO_ITEM_SET_GENERATED(item);
+}
+
+static void add_airtime(proto_tree *tree, int hf, tvbuff_t *tvb, guint32 offset, guint16 rate_info, guint16 pkt_len)
+{
+	guint32 airtime = topdog_airtime_us(rate_info, pkt_len);
+	proto_item *item;
+
+	if (airtime == 0)
+		return;
+
+	item = proto_tree_add_uint(tree, hf, tvb, offset, 2, airtime);
+	PROTO_ITEM_SET_GENERATED(item);
+}
+
+static void dissect_fw_type_0(proto_tree *tree, tvbuff_t *tvb, guint32 offset, packet_info *pinfo)
+{
+	topdog_frame_info *info;
+	proto_item *item;
+
+	proto_tree_add_item(tree, hf_pdu_type, tvb, offset+0, 4, ENC_LITTLE_ENDIAN);
+	if (tvb_bytes_exist(tvb, offset+TOPDOG_FW_SEQ_NUM, 4))
+		proto_tree_add_item(tree, hf_fw_seq_num, tvb, offset+TOPDOG_FW_SEQ_NUM, 4, ENC_LITTLE_ENDIAN);
+
+	info = (topdog_frame_info *)p_get_proto_data(wmem_file_scope(), pinfo, proto_topdog, 0);
+	if (info != NULL && info->peer_frame != 0) {
+		item = proto_tree_add_uint(tree, hf_fw_request_in, tvb, 0, 0, info->peer_frame);
+		PROTO_ITEM_SET_GENERATED(item);
+		item = proto_tree_add_time(tree, hf_fw_time, tvb, 0, 0, &info->rtt);
+		PROTO_ITEM_SET_GENERATED(item);
+	}
+}
+
+static void dissect_fw_type_1_4(proto_tree *tree, tvbuff_t *tvb, guint32 offset, packet_info *pinfo)
+{
+	guint32 data_size, data_len;
+	topdog_frame_info *info;
+	guint flags = PROTO_CHECKSUM_NO_FLAGS;
+	guint32 header_crc = 0, data_crc = 0;
+
+	/* A header that wasn't fully captured shows just its type. */
+	proto_tree_add_item(tree, hf_pdu_type, tvb, offset+0, 4, ENC_LITTLE_ENDIAN);
+	if (!tvb_bytes_exist(tvb, offset, TOPDOG_FW_HEADER_LEN))
+		return;
+	data_size = tvb_get_letohl(tvb, offset+TOPDOG_FW_DATA_SIZE);
+	data_len = MIN(data_size, (guint32)tvb_captured_length_remaining(tvb, offset+TOPDOG_FW_HEADER_LEN));
+
+	/* The CRCs were computed once on the first pass; see get_frame_info. */
+	info = (topdog_frame_info *)p_get_proto_data(wmem_file_scope(), pinfo, proto_topdog, 0);
+	if (info != NULL && info->fw_crc_computed) {
+		flags = PROTO_CHECKSUM_VERIFY;
+		header_crc = info->fw_header_crc;
+		data_crc = info->fw_data_crc;
+	}
+
+	proto_tree_add_item(tree, hf_fw_dest_addr, tvb, offset+TOPDOG_FW_DEST_ADDR, 4, ENC_LITTLE_ENDIAN);
+	proto_tree_add_item(tree, hf_fw_data_size, tvb, offset+TOPDOG_FW_DATA_SIZE, 4, ENC_LITTLE_ENDIAN);
+	proto_tree_add_checksum(tree, tvb, offset+TOPDOG_FW_HEADER_CRC, hf_fw_header_checksum, hf_fw_header_checksum_status,
+		&ei_fw_bad_checksum, pinfo, header_crc, ENC_BIG_ENDIAN, flags);
+	if (data_len != 0)
+		proto_tree_add_item(tree, hf_fw_data, tvb, offset+TOPDOG_FW_HEADER_LEN, data_len, ENC_LITTLE_ENDIAN);
+	if (data_len == data_size && tvb_bytes_exist(tvb, offset+TOPDOG_FW_HEADER_LEN+data_size, TOPDOG_FW_CRC_LEN))
+		proto_tree_add_checksum(tree, tvb, offset+TOPDOG_FW_HEADER_LEN+data_size, hf_fw_data_checksum, hf_fw_data_checksum_status,
+			&ei_fw_bad_checksum, pinfo, data_crc, ENC_BIG_ENDIAN, flags);
+
+	if (info != NULL && info->peer_frame != 0) {
+		proto_item *item = proto_tree_add_uint(tree, hf_fw_response_in, tvb, 0, 0, info->peer_frame);
+		PROTO_ITEM_SET_GENERATED(item);
+	}
+}
+
+/* Command bodies. Layouts follow the mwl8k firmware interface; the offset
+** passed in is that of the body, right after the 8-byte command header. */
+static void dissect_cmd_get_hw_spec(proto_tree *tree, tvbuff_t *tvb, guint32 offset, guint32 len)
+{
+	int i;
+
+	if (len < 76)
+		return;
+
+	proto_tree_add_item(tree, hf_hw_spec_hw_rev, tvb, offset+0, 1, ENC_LITTLE_ENDIAN);
+	proto_tree_add_item(tree, hf_hw_spec_host_interface, tvb, offset+1, 1, ENC_LITTLE_ENDIAN);
+	proto_tree_add_item(tree, hf_hw_spec_num_mcaddrs, tvb, offset+2, 2, ENC_LITTLE_ENDIAN);
+	proto_tree_add_item(tree, hf_hw_spec_perm_addr, tvb, offset+4, 6, ENC_NA);
+	proto_tree_add_item(tree, hf_hw_spec_region_code, tvb, offset+10, 2, ENC_LITTLE_ENDIAN);
+	proto_tree_add_item(tree, hf_hw_spec_fw_rev, tvb, offset+12, 4, ENC_LITTLE_ENDIAN);
+	proto_tree_add_item(tree, hf_hw_spec_ps_cookie, tvb, offset+16, 4, ENC_LITTLE_ENDIAN);
+	proto_tree_add_item(tree, hf_hw_spec_caps, tvb, offset+20, 4, ENC_LITTLE_ENDIAN);
+	proto_tree_add_item(tree, hf_hw_spec_mcs_bitmap, tvb, offset+24, 16, ENC_NA);
+	proto_tree_add_item(tree, hf_hw_spec_rx_queue_ptr, tvb, offset+40, 4, ENC_LITTLE_ENDIAN);
+	proto_tree_add_item(tree, hf_hw_spec_num_tx_queues, tvb, offset+44, 4, ENC_LITTLE_ENDIAN);
+	for (i = 0; i < 4; i++)
+		proto_tree_add_item(tree, hf_hw_spec_tx_queue_ptr, tvb, offset+48+4*i, 4, ENC_LITTLE_ENDIAN);
+	proto_tree_add_item(tree, hf_hw_spec_caps2, tvb, offset+64, 4, ENC_LITTLE_ENDIAN);
+	proto_tree_add_item(tree, hf_hw_spec_num_tx_desc_per_queue, tvb, offset+68, 4, ENC_LITTLE_ENDIAN);
+	proto_tree_add_item(tree, hf_hw_spec_total_rxd, tvb, offset+72, 4, ENC_LITTLE_ENDIAN);
+}
+
+static void dissect_cmd_rf_channel(proto_tree *tree, tvbuff_t *tvb, guint32 offset, guint32 len)
+{
+	if (len < 7)
+		return;
+
+	proto_tree_add_item(tree, hf_cmd_action, tvb, offset+0, 2, ENC_LITTLE_ENDIAN);
+	proto_tree_add_item(tree, hf_rf_channel_channel, tvb, offset+2, 1, ENC_LITTLE_ENDIAN);
+	proto_tree_add_item(tree, hf_rf_channel_flags, tvb, offset+3, 4, ENC_LITTLE_ENDIAN);
+}
+
+static void dissect_cmd_set_edca_params(proto_tree *tree, tvbuff_t *tvb, guint32 offset, guint32 len)
+{
+	if (len < 14)
+		return;
+
+	proto_tree_add_item(tree, hf_cmd_action, tvb, offset+0, 2, ENC_LITTLE_ENDIAN);
+	proto_tree_add_item(tree, hf_edca_txop, tvb, offset+2, 2, ENC_LITTLE_ENDIAN);
+	proto_tree_add_item(tree, hf_edca_log_cw_max, tvb, offset+4, 4, ENC_LITTLE_ENDIAN);
+	proto_tree_add_item(tree, hf_edca_log_cw_min, tvb, offset+8, 4, ENC_LITTLE_ENDIAN);
+	proto_tree_add_item(tree, hf_edca_aifs, tvb, offset+12, 1, ENC_LITTLE_ENDIAN);
+	proto_tree_add_item(tree, hf_edca_txq, tvb, offset+13, 1, ENC_LITTLE_ENDIAN);
+}
+
+static void dissect_cmd_set_rate(proto_tree *tree, tvbuff_t *tvb, guint32 offset, guint32 len)
+{
+	if (len < 30)
+		return;
+
+	proto_tree_add_item(tree, hf_set_rate_legacy_rates, tvb, offset+0, 14, ENC_NA);
+	proto_tree_add_item(tree, hf_set_rate_mcs_set, tvb, offset+14, 16, ENC_NA);
+}
+
+static void dissect_cmd_set_new_stn(proto_tree *tree, tvbuff_t *tvb, guint32 offset, guint32 len)
+{
+	if (len < 40)
+		return;
+
+	proto_tree_add_item(tree, hf_new_stn_aid, tvb, offset+0, 2, ENC_LITTLE_ENDIAN);
+	proto_tree_add_item(tree, hf_new_stn_mac_addr, tvb, offset+2, 6, ENC_NA);
+	proto_tree_add_item(tree, hf_new_stn_stn_id, tvb, offset+8, 2, ENC_LITTLE_ENDIAN);
+	proto_tree_add_item(tree, hf_new_stn_action, tvb, offset+10, 2, ENC_LITTLE_ENDIAN);
+	proto_tree_add_item(tree, hf_new_stn_legacy_rates, tvb, offset+14, 4, ENC_LITTLE_ENDIAN);
+	proto_tree_add_item(tree, hf_new_stn_ht_rates, tvb, offset+18, 4, ENC_NA);
+	proto_tree_add_item(tree, hf_new_stn_cap_info, tvb, offset+22, 2, ENC_LITTLE_ENDIAN);
+	proto_tree_add_item(tree, hf_new_stn_ht_cap_info, tvb, offset+24, 2, ENC_LITTLE_ENDIAN);
+	proto_tree_add_item(tree, hf_new_stn_mac_ht_param_info, tvb, offset+26, 1, ENC_LITTLE_ENDIAN);
+	proto_tree_add_item(tree, hf_new_stn_control_channel, tvb, offset+28, 1, ENC_LITTLE_ENDIAN);
+	proto_tree_add_item(tree, hf_new_stn_add_channel, tvb, offset+29, 1, ENC_LITTLE_ENDIAN);
+	proto_tree_add_item(tree, hf_new_stn_op_mode, tvb, offset+30, 2, ENC_LITTLE_ENDIAN);
+	proto_tree_add_item(tree, hf_new_stn_stbc, tvb, offset+32, 2, ENC_LITTLE_ENDIAN);
+	proto_tree_add_item(tree, hf_new_stn_is_qos_sta, tvb, offset+35, 1, ENC_LITTLE_ENDIAN);
+	proto_tree_add_item(tree, hf_new_stn_fw_sta_ptr, tvb, offset+36, 4, ENC_LITTLE_ENDIAN);
+}
+
+static void dissect_cmd_bastream(proto_tree *tree, tvbuff_t *tvb, guint32 offset, guint32 len)
+{
+	guint32 action;
+
+	if (len < 4)
+		return;
+
+	action = tvb_get_letohl(tvb, offset);
+	proto_tree_add_item(tree, hf_bastream_action, tvb, offset+0, 4, ENC_LITTLE_ENDIAN);
+
+	/* Destroy takes flags and the BA context; every other action the
+	** create parameters. */
+	if (action == TOPDOG_BA_DESTROY) {
+		if (len < 12)
+			return;
+		proto_tree_add_item(tree, hf_bastream_flags, tvb, offset+4, 4, ENC_LITTLE_ENDIAN);
+		proto_tree_add_item(tree, hf_bastream_ba_context, tvb, offset+8, 4, ENC_LITTLE_ENDIAN);
+		return;
+	}
+
+	if (len < 43)
+		return;
+	proto_tree_add_item(tree, hf_bastream_flags, tvb, offset+4, 4, ENC_LITTLE_ENDIAN);
+	proto_tree_add_item(tree, hf_bastream_idle_thrs, tvb, offset+8, 4, ENC_LITTLE_ENDIAN);
+	proto_tree_add_item(tree, hf_bastream_bar_thrs, tvb, offset+12, 4, ENC_LITTLE_ENDIAN);
+	proto_tree_add_item(tree, hf_bastream_window_size, tvb, offset+16, 4, ENC_LITTLE_ENDIAN);
+	proto_tree_add_item(tree, hf_bastream_peer_mac_addr, tvb, offset+20, 6, ENC_NA);
+	proto_tree_add_item(tree, hf_bastream_dialog_token, tvb, offset+26, 1, ENC_LITTLE_ENDIAN);
+	proto_tree_add_item(tree, hf_bastream_tid, tvb, offset+27, 1, ENC_LITTLE_ENDIAN);
+	proto_tree_add_item(tree, hf_bastream_queue_id, tvb, offset+28, 1, ENC_LITTLE_ENDIAN);
+	proto_tree_add_item(tree, hf_bastream_param_info, tvb, offset+29, 1, ENC_LITTLE_ENDIAN);
+	proto_tree_add_item(tree, hf_bastream_ba_context, tvb, offset+30, 4, ENC_LITTLE_ENDIAN);
+	proto_tree_add_item(tree, hf_bastream_curr_seq_no, tvb, offset+35, 2, ENC_LITTLE_ENDIAN);
+	proto_tree_add_item(tree, hf_bastream_sta_src_mac_addr, tvb, offset+37, 6, ENC_NA);
+}
+
+static void dissect_cmd_set_rateadapt_mode(proto_tree *tree, tvbuff_t *tvb, guint32 offset, guint32 len)
+{
+	if (len < 4)
+		return;
+
+	proto_tree_add_item(tree, hf_cmd_action, tvb, offset+0, 2, ENC_LITTLE_ENDIAN);
+	proto_tree_add_item(tree, hf_rateadapt_mode, tvb, offset+2, 2, ENC_LITTLE_ENDIAN);
+}
+
+/* Dense command lookup. cmd_slots maps a command code, with the response bit
+** masked off, to its entry in cmd_table; slot 0 means unknown. Both are built
+** from cmd_types at registration, so slots follow cmd_types order. */
+typedef void (*cmd_body_dissector)(proto_tree *tree, tvbuff_t *tvb, guint32 offset, guint32 len);
+
+typedef struct _topdog_cmd_entry {
+	guint16 code;
+	const char *request_name;
+	const char *response_name;
+	cmd_body_dissector dissect_body;
+} topdog_cmd_entry;
+
+static const struct {
+	guint16 code;
+	cmd_body_dissector dissect_body;
+} cmd_body_dissectors[] = {
+	{0x0003, dissect_cmd_get_hw_spec},
+	{0x001d, dissect_cmd_rf_channel},
+	{0x010a, dissect_cmd_rf_channel},
+	{0x0110, dissect_cmd_set_rate},
+	{0x0115, dissect_cmd_set_edca_params},
+	{0x0203, dissect_cmd_set_rateadapt_mode},
+	{0x1111, dissect_cmd_set_new_stn},
+	{0x1125, dissect_cmd_bastream}
+};
+
+static guint8 cmd_slots[TOPDOG_CMD_CODE_LIMIT];
+static topdog_cmd_entry cmd_table[256];
+static guint num_cmd_slots = 0;
+
+static void build_cmd_table(void)
+{
+	const value_string *vs;
+	guint i;
+
+	for (vs = cmd_types; vs->strptr != NULL; vs++) {
+		guint16 code = vs->value & ~TOPDOG_CMD_RESPONSE;
+		guint8 slot = cmd_slots[code];
+
+		if (slot == 0) {
+			slot = cmd_slots[code] = ++num_cmd_slots;
+			cmd_table[slot].code = code;
+		}
+		if (vs->value & TOPDOG_CMD_RESPONSE)
+			cmd_table[slot].response_name = vs->strptr;
+		else
+			cmd_table[slot].request_name = vs->strptr;
+	}
+
+	for (i = 0; i < array_length(cmd_body_dissectors); i++)
+		cmd_table[cmd_slots[cmd_body_dissectors[i].code]].dissect_body = cmd_body_dissectors[i].dissect_body;
+}
+
+static const topdog_cmd_entry *lookup_cmd(guint16 cmd)
+{
+	guint16 code = cmd & ~TOPDOG_CMD_RESPONSE;
+
+	if (code >= TOPDOG_CMD_CODE_LIMIT || cmd_slots[code] == 0)
+		return NULL;
+
+	return &cmd_table[cmd_slots[code]];
+}
+
+static const char *cmd_name(guint16 cmd)
+{
+	const topdog_cmd_entry *entry = lookup_cmd(cmd);
+
+	if (entry == NULL)
+		return NULL;
+
+	return (cmd & TOPDOG_CMD_RESPONSE) ? entry->response_name : entry->request_name;
+}
+
+static void format_cmd(gchar *result, guint32 cmd)
+{
+	const char *name = cmd_name((guint16)cmd);
+
+	g_snprintf(result, ITEM_LABEL_LENGTH, "%s (0x%04x)", name ? name : "Unknown", cmd);
+}
+
+/* Adds up to len bytes of hf at offset, cut to what was captured, so a short
+** snaplen doesn't throw. Returns NULL if nothing at offset was captured. */
+static proto_item *add_captured_bytes(proto_tree *tree, int hf, tvbuff_t *tvb, guint32 offset, guint32 len)
+{
+	gint captured = tvb_captured_length_remaining(tvb, offset);
+
+	if (captured <= 0)
+		return NULL;
+
+	return proto_tree_add_item(tree, hf, tvb, offset, MIN((guint32)captured, len), ENC_NA);
+}
+
+static void dissect_cmd_body(proto_tree *tree, tvbuff_t *tvb, guint32 offset)
+{
+	guint16 cmd = tvb_get_letohs(tvb, offset+TOPDOG_CMD_CODE);
+	guint16 cmd_len = tvb_get_letohs(tvb, offset+TOPDOG_CMD_LEN);
+	const topdog_cmd_entry *entry = lookup_cmd(cmd);
+	proto_item *body_item;
+	guint32 body_len;
+
+	if (cmd_len < 8)
+		return;
+
+	body_item = add_captured_bytes(tree, hf_cmd_body, tvb, offset+TOPDOG_CMD_HEADER_LEN, cmd_len-8);
+	if (body_item == NULL || entry == NULL || entry->dissect_body == NULL)
+		return;
+
+	/* Decoders check the length they get, so a cut body is left raw. */
+	body_len = MIN((guint32)tvb_captured_length_remaining(tvb, offset+TOPDOG_CMD_HEADER_LEN), (guint32)cmd_len-8);
+	entry->dissect_body(proto_item_add_subtree(body_item, ett_cmd_body), tvb, offset+TOPDOG_CMD_HEADER_LEN, body_len);
+}
+
+static void dissect_topdog_mcbw(proto_tree *tree, tvbuff_t *tvb, guint32 offset, packet_info *pinfo)
+{
+	topdog_frame_info *info;
+	proto_item *item;
+
+	proto_tree_add_item(tree, hf_pdu_type, tvb, offset+0, 4, ENC_LITTLE_ENDIAN);
+	proto_tree_add_item(tree, hf_tag, tvb, offset+TOPDOG_CMD_TAG, 2, ENC_LITTLE_ENDIAN);
+	proto_tree_add_item(tree, hf_transfer_len, tvb, offset+6, 2, ENC_LITTLE_ENDIAN);
+	proto_tree_add_item(tree, hf_fun_flag, tvb, offset+8, 2, ENC_LITTLE_ENDIAN);
+	proto_tree_add_item(tree, hf_cmd_wrapper_len, tvb, offset+10, 2, ENC_LITTLE_ENDIAN);
+	proto_tree_add_item(tree, hf_cmd, tvb, offset+TOPDOG_CMD_CODE, 2, ENC_LITTLE_ENDIAN);
+	proto_tree_add_item(tree, hf_cmd_len, tvb, offset+TOPDOG_CMD_LEN, 2, ENC_LITTLE_ENDIAN);
+	proto_tree_add_item(tree, hf_cmd_seq_num, tvb, offset+TOPDOG_CMD_SEQ_NUM, 2, ENC_LITTLE_ENDIAN);
+	proto_tree_add_item(tree, hf_cmd_result, tvb, offset+TOPDOG_CMD_RESULT, 2, ENC_LITTLE_ENDIAN);
+	dissect_cmd_body(tree, tvb, offset);
+
+	info = (topdog_frame_info *)p_get_proto_data(wmem_file_scope(), pinfo, proto_topdog, 0);
+	if (info == NULL)
+		return;
+	if (info->peer_frame != 0) {
+		item = proto_tree_add_uint(tree, hf_response_in, tvb, 0, 0, info->peer_frame);
+		PROTO_ITEM_SET_GENERATED(item);
+	} else if (info->evicted) {
+		proto_tree_add_expert_format(tree, pinfo, &ei_state_evicted, tvb, offset, 20,
+			"Command dropped from the matching table before its response");
+	} else if (PINFO_FD_VISITED(pinfo)) {
+		/* On the first pass the response may simply not have been seen yet. */
+		proto_tree_add_expert(tree, pinfo, &ei_cmd_no_response, tvb, offset, 20);
+	}
+}
+
+static void dissect_topdog_mcsw(proto_tree *tree, tvbuff_t *tvb, guint32 offset, packet_info *pinfo)
+{
+	topdog_frame_info *info;
+	proto_item *item;
+
+	proto_tree_add_item(tree, hf_pdu_type, tvb, offset+0, 4, ENC_LITTLE_ENDIAN);
+	proto_tree_add_item(tree, hf_tag, tvb, offset+TOPDOG_CMD_TAG, 2, ENC_LITTLE_ENDIAN);
+	proto_tree_add_item(tree, hf_data_residue, tvb, offset+6, 2, ENC_LITTLE_ENDIAN);
+	proto_tree_add_item(tree, hf_status, tvb, offset+8, 2, ENC_LITTLE_ENDIAN);
+	proto_tree_add_item(tree, hf_cmd_wrapper_len, tvb, offset+10, 2, ENC_LITTLE_ENDIAN);
+	proto_tree_add_item(tree, hf_cmd, tvb, offset+TOPDOG_CMD_CODE, 2, ENC_LITTLE_ENDIAN);
+	proto_tree_add_item(tree, hf_cmd_len, tvb, offset+TOPDOG_CMD_LEN, 2, ENC_LITTLE_ENDIAN);
+	proto_tree_add_item(tree, hf_cmd_seq_num, tvb, offset+TOPDOG_CMD_SEQ_NUM, 2, ENC_LITTLE_ENDIAN);
+	proto_tree_add_item(tree, hf_cmd_result, tvb, offset+TOPDOG_CMD_RESULT, 2, ENC_LITTLE_ENDIAN);
+	dissect_cmd_body(tree, tvb, offset);
+
+	info = (topdog_frame_info *)p_get_proto_data(wmem_file_scope(), pinfo, proto_topdog, 0);
+	if (info != NULL && info->peer_frame != 0) {
+		item = proto_tree_add_uint(tree, hf_request_in, tvb, 0, 0, info->peer_frame);
+		PROTO_ITEM_SET_GENERATED(item);
+		item = proto_tree_add_time(tree, hf_time, tvb, 0, 0, &info->rtt);
+		PROTO_ITEM_SET_GENERATED(item);
+	}
+}
+
+/* Locates the 802.11 frame behind the WCB or RxPD at offset. Returns FALSE
+** if none of it was captured. */
+static gboolean topdog_wlan_frame(tvbuff_t *tvb, guint32 offset, guint32 pdu_type,
+	guint32 *wlan_offset, gint *wlan_len)
+{
+	guint32 len_offset = offset + TOPDOG_DESC_HEADER_LEN(pdu_type);
+
+	if (!tvb_bytes_exist(tvb, len_offset, 2) || tvb_captured_length_remaining(tvb, len_offset+2) <= 0)
+		return FALSE;
+
+	*wlan_offset = len_offset + 2;
+	/* A WCB counts only the body after the 30-byte four-address header; an
+	** RxPD counts the length field itself. */
+	if (pdu_type == TOPDOG_PDU_MTXD)
+		*wlan_len = tvb_get_letohs(tvb, len_offset) + 30;
+	else
+		*wlan_len = tvb_get_letohs(tvb, len_offset) - 2;
+	return TRUE;
+}
+
+static void dissect_topdog_mtxd(proto_tree *tree, tvbuff_t *tvb, guint32 offset, packet_info *pinfo)
+{
+	guint16 pkt_len;
+	guint32 wlan_offset;
+	gint wlan_len;
+
+	proto_tree_add_item(tree, hf_pdu_type, tvb, offset+0, 4, ENC_LITTLE_ENDIAN);
+	if (!tvb_bytes_exist(tvb, offset, TOPDOG_WCB_LEN))
+		return;
+
+	pkt_len = tvb_get_letohs(tvb, offset+TOPDOG_WCB_PKT_LEN);
+	proto_tree_add_item(tree, hf_wcb_ctrl_stat, tvb, offset+TOPDOG_WCB_CTRL_STAT, 2, ENC_LITTLE_ENDIAN);
+	proto_tree_add_item(tree, hf_wcb_tx_pri, tvb, offset+TOPDOG_WCB_TX_PRI, 1, ENC_LITTLE_ENDIAN);
+	proto_tree_add_item(tree, hf_wcb_tx_frag_count, tvb, offset+TOPDOG_WCB_TX_FRAG_COUNT, 1, ENC_LITTLE_ENDIAN);
+	proto_tree_add_bitmask(tree, tvb, offset+TOPDOG_WCB_QOS_CTRL,
+		hf_wcb_qos_ctrl, ett_qos_ctrl, qos_ctrl_flags, ENC_LITTLE_ENDIAN);
+	proto_tree_add_item(tree, hf_wcb_pkt_ptr, tvb, offset+TOPDOG_WCB_PKT_PTR, 4, ENC_LITTLE_ENDIAN);
+	proto_tree_add_item(tree, hf_wcb_pkt_len, tvb, offset+TOPDOG_WCB_PKT_LEN, 2, ENC_LITTLE_ENDIAN);
+	proto_tree_add_item(tree, hf_wcb_dest_mac, tvb, offset+TOPDOG_WCB_DEST_MAC, 6, ENC_LITTLE_ENDIAN);
+	proto_tree_add_item(tree, hf_wcb_next_ptr, tvb, offset+TOPDOG_WCB_NEXT_PTR, 4, ENC_LITTLE_ENDIAN);
+	proto_tree_add_bitmask(tree, tvb, offset+TOPDOG_WCB_RATE_INFO,
+		hf_wcb_rate_info, ett_rate_info, rate_info_flags, ENC_LITTLE_ENDIAN);
+	add_phy_rate(tree, hf_wcb_phy_rate, tvb, offset+TOPDOG_WCB_RATE_INFO,
+		tvb_get_letohs(tvb, offset+TOPDOG_WCB_RATE_INFO));
+	add_airtime(tree, hf_wcb_airtime, tvb, offset+TOPDOG_WCB_RATE_INFO,
+		tvb_get_letohs(tvb, offset+TOPDOG_WCB_RATE_INFO), pkt_len);
+	proto_tree_add_item(tree, hf_wcb_reserved, tvb, offset+TOPDOG_WCB_RESERVED, 4, ENC_LITTLE_ENDIAN);
+	add_captured_bytes(tree, hf_wlan_pkt, tvb, offset+TOPDOG_WCB_LEN, pkt_len);
+
+	if (!topdog_wlan_frame(tvb, offset, TOPDOG_PDU_MTXD, &wlan_offset, &wlan_len))
+		return;
+	call_dissector(wlan_handle, tvb_new_subset_length(tvb, wlan_offset, wlan_len), pinfo, proto_tree_get_parent_tree(tree));
+}
+
+static void dissect_topdog_mrxd(proto_tree *tree, tvbuff_t *tvb, guint32 offset, packet_info *pinfo)
+{
+	guint16 pkt_len;
+	guint32 wlan_offset;
+	gint wlan_len;
+
+	proto_tree_add_item(tree, hf_pdu_type, tvb, offset+0, 4, ENC_LITTLE_ENDIAN);
+	if (!tvb_bytes_exist(tvb, offset, TOPDOG_RXPD_LEN))
+		return;
+
+	pkt_len = tvb_get_letohs(tvb, offset+TOPDOG_RXPD_PKT_LEN);
+	proto_tree_add_item(tree, hf_rxpd_rx_ctrl, tvb, offset+TOPDOG_RXPD_RX_CTRL, 1, ENC_LITTLE_ENDIAN);
+	proto_tree_add_item(tree, hf_rxpd_rssi, tvb, offset+TOPDOG_RXPD_RSSI, 1, ENC_LITTLE_ENDIAN);
+	proto_tree_add_item(tree, hf_rxpd_channel, tvb, offset+TOPDOG_RXPD_CHANNEL, 1, ENC_LITTLE_ENDIAN);
+	proto_tree_add_item(tree, hf_rxpd_noise_lvl, tvb, offset+TOPDOG_RXPD_NOISE_LVL, 1, ENC_LITTLE_ENDIAN);
+	proto_tree_add_item(tree, hf_rxpd_pkt_len, tvb, offset+TOPDOG_RXPD_PKT_LEN, 2, ENC_LITTLE_ENDIAN);
+	proto_tree_add_item(tree, hf_rxpd_next_ptr, tvb, offset+TOPDOG_RXPD_NEXT_PTR, 2, ENC_LITTLE_ENDIAN);
+	proto_tree_add_bitmask(tree, tvb, offset+TOPDOG_RXPD_QOS_CTRL,
+		hf_rxpd_qos_ctrl, ett_qos_ctrl, qos_ctrl_flags, ENC_LITTLE_ENDIAN);
+	proto_tree_add_bitmask(tree, tvb, offset+TOPDOG_RXPD_CTRL,
+		hf_rxpd_rxpd_ctrl, ett_rxpd_ctrl, rxpd_ctrl_flags, ENC_LITTLE_ENDIAN);
+	proto_tree_add_bitmask(tree, tvb, offset+TOPDOG_RXPD_RX_RATE_INFO,
+		hf_rxpd_rx_rate_info, ett_rate_info, rate_info_flags, ENC_LITTLE_ENDIAN);
+	proto_tree_add_bitmask(tree, tvb, offset+TOPDOG_RXPD_TX_RATE_INFO,
+		hf_rxpd_tx_rate_info, ett_rate_info, rate_info_flags, ENC_LITTLE_ENDIAN);
+	add_phy_rate(tree, hf_rxpd_rx_phy_rate, tvb, offset+TOPDOG_RXPD_RX_RATE_INFO,
+		tvb_get_letohs(tvb, offset+TOPDOG_RXPD_RX_RATE_INFO));
+	add_phy_rate(tree, hf_rxpd_tx_phy_rate, tvb, offset+TOPDOG_RXPD_TX_RATE_INFO,
+		tvb_get_letohs(tvb, offset+TOPDOG_RXPD_TX_RATE_INFO));
+	add_airtime(tree, hf_rxpd_airtime, tvb, offset+TOPDOG_RXPD_RX_RATE_INFO,
+		tvb_get_letohs(tvb, offset+TOPDOG_RXPD_RX_RATE_INFO), pkt_len);
+	add_captured_bytes(tree, hf_wlan_pkt, tvb, offset+TOPDOG_RXPD_LEN, pkt_len);
+
+	if (!topdog_wlan_frame(tvb, offset, TOPDOG_PDU_MRXD, &wlan_offset, &wlan_len))
+		return;
+	call_dissector(wlan_handle, tvb_new_subset_length(tvb, wlan_offset, wlan_len), pinfo, proto_tree_get_parent_tree(tree));
+}
+
+static void add_tx_ring_fields(proto_tree *tree, tvbuff_t *tvb, packet_info *pinfo, const topdog_desc *desc)
+{
+	proto_item *item;
+
+	if (!desc->ring_tracked)
+		return;
+
+	item = proto_tree_add_uint(tree, hf_wcb_ring_occupancy, tvb, desc->offset+TOPDOG_WCB_TX_PRI, 1, desc->ring_occupancy);
+	PROTO_ITEM_SET_GENERATED(item);
+	if (desc->ring_full)
+		expert_add_info(pinfo, item, &ei_tx_ring_full);
+	item = proto_tree_add_uint(tree, hf_wcb_ring_high_water, tvb, desc->offset+TOPDOG_WCB_TX_PRI, 1, desc->ring_high_water);
+	PROTO_ITEM_SET_GENERATED(item);
+	item = proto_tree_add_uint(tree, hf_wcb_ring_size, tvb, desc->offset+TOPDOG_WCB_TX_PRI, 1, desc->ring_size);
+	PROTO_ITEM_SET_GENERATED(item);
+}
+
+/* Transfer bytes left over once every descriptor header and payload is
+** accounted for. */
+static guint32 topdog_urb_padding(const topdog_frame_info *info)
+{
+	guint32 used = info->header_bytes + info->payload_bytes;
+
+	return info->urb_len > used ? info->urb_len - used : 0;
+}
+
+/* Dissects the descriptors found by cache_chain, so redissection jumps
+** straight to each one instead of re-walking the next pointers. */
+static void dissect_pdu(proto_tree *tree, tvbuff_t *tvb, packet_info *pinfo, const topdog_frame_info *info)
+{
+	proto_item *item;
+	guint32 i;
+
+	for (i = 0; i < info->chain_count; i++) {
+		guint32 offset = info->descs[i].offset;
+
+		switch (info->descs[i].pdu_type) {
+		case TOPDOG_FW_RESPONSE: dissect_fw_type_0(tree, tvb, offset, pinfo); break;
+		case TOPDOG_FW_SET: case TOPDOG_FW_SET_AND_EXECUTE: dissect_fw_type_1_4(tree, tvb, offset, pinfo); break;
+		case TOPDOG_PDU_MCBW: dissect_topdog_mcbw(tree, tvb, offset, pinfo); break;
+		case TOPDOG_PDU_MCSW: dissect_topdog_mcsw(tree, tvb, offset, pinfo); break;
+		case TOPDOG_PDU_MTXD:
+			dissect_topdog_mtxd(tree, tvb, offset, pinfo);
+			add_tx_ring_fields(tree, tvb, pinfo, &info->descs[i]);
+			break;
+		case TOPDOG_PDU_MRXD: dissect_topdog_mrxd(tree, tvb, offset, pinfo); break;
+		}
+	}
+
+	item = proto_tree_add_uint(tree, hf_chain_len, tvb, 0, 0, info->chain_count);
+	PROTO_ITEM_SET_GENERATED(item);
+
+	if (info->pdu_type == TOPDOG_PDU_MTXD || info->pdu_type == TOPDOG_PDU_MRXD) {
+		proto_item *urb_item;
+
+		urb_item = proto_tree_add_uint(tree, hf_urb_len, tvb, 0, 0, info->urb_len);
+		PROTO_ITEM_SET_GENERATED(urb_item);
+		urb_item = proto_tree_add_uint(tree, hf_urb_payload_len, tvb, 0, 0, info->payload_bytes);
+		PROTO_ITEM_SET_GENERATED(urb_item);
+		urb_item = proto_tree_add_uint(tree, hf_urb_header_len, tvb, 0, 0, info->header_bytes);
+		PROTO_ITEM_SET_GENERATED(urb_item);
+		urb_item = proto_tree_add_uint(tree, hf_urb_padding, tvb, 0, 0, topdog_urb_padding(info));
+		PROTO_ITEM_SET_GENERATED(urb_item);
+	}
+
+	if (info->chain_status == TOPDOG_CHAIN_BAD_NEXT_PTR)
+		expert_add_info(pinfo, item, &ei_chain_bad_next_ptr);
+	else if (info->chain_status == TOPDOG_CHAIN_TOO_LONG)
+		expert_add_info(pinfo, item, &ei_chain_too_long);
+}
+
+/* Walks the descriptor chain once, on the first pass, and keeps the offset,
+** type and packet length of every descriptor in the frame info. */
+static void cache_chain(tvbuff_t *tvb, topdog_frame_info *info)
+{
+	wmem_array_t *descs = wmem_array_new(wmem_packet_scope(), sizeof(topdog_desc));
+	guint32 offset = 0;
+	gboolean bad = FALSE;
+
+	while (tvb_bytes_exist(tvb, offset, 4)) {
+		topdog_desc desc;
+		guint32 next_ptr = 0;
+
+		memset(&desc, 0, sizeof desc);
+		desc.pdu_type = tvb_get_letohl(tvb, offset);
+		desc.offset = offset;
+
+		if (desc.pdu_type == TOPDOG_PDU_MTXD || desc.pdu_type == TOPDOG_PDU_MRXD) {
+			guint32 header_len = TOPDOG_DESC_HEADER_LEN(desc.pdu_type);
+			guint32 lengths_end = TOPDOG_DESC_LENGTHS_END(desc.pdu_type);
+			guint32 pkt_len;
+
+			if (tvb_bytes_exist(tvb, offset, lengths_end)) {
+				topdog_desc_lengths(tvb_get_ptr(tvb, offset, lengths_end), desc.pdu_type, &pkt_len, &next_ptr);
+				desc.pkt_len = pkt_len;
+				info->header_bytes += header_len;
+				info->payload_bytes += pkt_len;
+				if (!tvb_bytes_exist(tvb, offset, header_len + pkt_len))
+					info->truncated = TRUE;
+			} else {
+				info->truncated = TRUE;
+			}
+		} else if (desc.pdu_type == TOPDOG_FW_RESPONSE) {
+			if (!tvb_bytes_exist(tvb, offset, TOPDOG_FW_RESPONSE_LEN))
+				info->truncated = TRUE;
+		} else if (desc.pdu_type == TOPDOG_FW_SET || desc.pdu_type == TOPDOG_FW_SET_AND_EXECUTE) {
+			guint32 data_size;
+
+			if (!tvb_bytes_exist(tvb, offset, TOPDOG_FW_HEADER_LEN)) {
+				info->truncated = TRUE;
+			} else {
+				data_size = tvb_get_letohl(tvb, offset+TOPDOG_FW_DATA_SIZE);
+				if (data_size > G_MAXINT - TOPDOG_FW_HEADER_LEN - TOPDOG_FW_CRC_LEN
+					|| !tvb_bytes_exist(tvb, offset, TOPDOG_FW_HEADER_LEN + data_size + TOPDOG_FW_CRC_LEN))
+					info->truncated = TRUE;
+			}
+		}
+		wmem_array_append_one(descs, desc);
+
+		if (!topdog_chain_advance(&offset, next_ptr, &bad))
+			break;
+		if (wmem_array_get_count(descs) == TOPDOG_MAX_CHAIN_HOPS) {
+			info->chain_status = TOPDOG_CHAIN_TOO_LONG;
+			break;
+		}
+	}
+
+	/* The walk stopped at a next pointer into data that wasn't captured. */
+	if (!tvb_bytes_exist(tvb, offset, 4) && offset < tvb_reported_length(tvb))
+		info->truncated = TRUE;
+	if (bad)
+		info->chain_status = TOPDOG_CHAIN_BAD_NEXT_PTR;
+	info->urb_len = tvb_reported_length(tvb);
+	info->chain_count = wmem_array_get_count(descs);
+	if (info->chain_count != 0)
+		info->descs = (topdog_desc *)wmem_memdup(wmem_file_scope(), wmem_array_get_raw(descs),
+			info->chain_count * sizeof(topdog_desc));
+}
+
+/* Publishes every RxPD and WCB in the transfer to the "topdog.rx" and
+** "topdog.tx" taps without building a tree. */
+static void queue_desc_infos(tvbuff_t *tvb, packet_info *pinfo, const topdog_frame_info *info)
+{
+	gboolean want_rx = have_tap_listener(topdog_rx_tap);
+	gboolean want_tx = have_tap_listener(topdog_tx_tap);
+	guint32 i;
+
+	for (i = 0; i < info->chain_count; i++) {
+		guint32 offset = info->descs[i].offset;
+
+		if (want_rx && info->descs[i].pdu_type == TOPDOG_PDU_MRXD
+			&& tvb_bytes_exist(tvb, offset, TOPDOG_RXPD_LEN)) {
+			topdog_rx_info *rx = wmem_new(wmem_packet_scope(), topdog_rx_info);
+
+			rx->rx_ctrl = tvb_get_guint8(tvb, offset+TOPDOG_RXPD_RX_CTRL);
+			rx->rssi = tvb_get_guint8(tvb, offset+TOPDOG_RXPD_RSSI);
+			rx->channel = tvb_get_guint8(tvb, offset+TOPDOG_RXPD_CHANNEL);
+			rx->noise_lvl = tvb_get_guint8(tvb, offset+TOPDOG_RXPD_NOISE_LVL);
+			rx->pkt_len = info->descs[i].pkt_len;
+			rx->qos_ctrl = tvb_get_letohs(tvb, offset+TOPDOG_RXPD_QOS_CTRL);
+			rx->rxpd_ctrl = tvb_get_letohs(tvb, offset+TOPDOG_RXPD_CTRL);
+			rx->rx_rate_info = tvb_get_letohs(tvb, offset+TOPDOG_RXPD_RX_RATE_INFO);
+			rx->tx_rate_info = tvb_get_letohs(tvb, offset+TOPDOG_RXPD_TX_RATE_INFO);
+			rx->tvb = tvb;
+			if (!topdog_wlan_frame(tvb, offset, TOPDOG_PDU_MRXD, &rx->wlan_offset, &rx->wlan_len))
+				rx->wlan_len = 0;
+			tap_queue_packet(topdog_rx_tap, pinfo, rx);
+		} else if (want_tx && info->descs[i].pdu_type == TOPDOG_PDU_MTXD
+			&& tvb_bytes_exist(tvb, offset, TOPDOG_WCB_RATE_INFO + 2)) {
+			topdog_tx_info *tx = wmem_new(wmem_packet_scope(), topdog_tx_info);
+
+			tx->ctrl_stat = tvb_get_letohs(tvb, offset+TOPDOG_WCB_CTRL_STAT);
+			tx->tx_pri = tvb_get_guint8(tvb, offset+TOPDOG_WCB_TX_PRI);
+			tx->tx_frag_count = tvb_get_guint8(tvb, offset+TOPDOG_WCB_TX_FRAG_COUNT);
+			tx->qos_ctrl = tvb_get_letohs(tvb, offset+TOPDOG_WCB_QOS_CTRL);
+			tx->pkt_ptr = tvb_get_letohl(tvb, offset+TOPDOG_WCB_PKT_PTR);
+			tx->pkt_len = info->descs[i].pkt_len;
+			tvb_memcpy(tvb, tx->dest_mac, offset+TOPDOG_WCB_DEST_MAC, 6);
+			tx->next_ptr = tvb_get_letohl(tvb, offset+TOPDOG_WCB_NEXT_PTR);
+			tx->rate_info = tvb_get_letohs(tvb, offset+TOPDOG_WCB_RATE_INFO);
+			tx->ring_tracked = info->descs[i].ring_tracked;
+			tx->ring_occupancy = info->descs[i].ring_occupancy;
+			tx->ring_size = info->descs[i].ring_size;
+			tx->ring_full = info->descs[i].ring_full;
+			tx->tvb = tvb;
+			if (!topdog_wlan_frame(tvb, offset, TOPDOG_PDU_MTXD, &tx->wlan_offset, &tx->wlan_len))
+				tx->wlan_len = 0;
+			tap_queue_packet(topdog_tx_tap, pinfo, tx);
+		}
+	}
+}
+
+static guint32 topdog_dev_key(usb_conv_info_t *usb_conv_info)
+{
+	if (usb_conv_info == NULL)
+		return 0;
+	return ((guint32)usb_conv_info->bus_id << 16) | usb_conv_info->device_address;
+}
+
+static topdog_dev_info *get_dev_info(usb_conv_info_t *usb_conv_info)
+{
+	guint32 key = topdog_dev_key(usb_conv_info);
+	topdog_dev_info *dev;
+
+	dev = (topdog_dev_info *)wmem_map_lookup(topdog_dev_infos, GUINT_TO_POINTER(key));
+	if (dev == NULL) {
+		dev = wmem_new0(wmem_file_scope(), topdog_dev_info);
+		dev->pending_cmds = wmem_map_new(wmem_file_scope(), g_direct_hash, g_direct_equal);
+		wmem_map_insert(topdog_dev_infos, GUINT_TO_POINTER(key), dev);
+	}
+
+	return dev;
+}
+
+static gboolean free_fw_extent(const void *key, void *value, void *userdata)
+{
+	topdog_fw_extent *extent = (topdog_fw_extent *)value;
+
+	wmem_free(wmem_file_scope(), (void *)extent->data);
+	extent->data = NULL;
+	return FALSE;
+}
+
+/* Adds a FW_SET / FW_SET_AND_EXECUTE chunk to the device's image. Sets
+** info->fw_image when the chunk is the final FW_SET_AND_EXECUTE. */
+static void add_fw_chunk(tvbuff_t *tvb, topdog_frame_info *info, usb_conv_info_t *usb_conv_info)
+{
+	topdog_dev_info *dev = get_dev_info(usb_conv_info);
+	topdog_fw_image *image = dev->fw_image;
+	guint32 data_size = info->fw_data_size;
+
+	if (image == NULL) {
+		image = wmem_new0(wmem_file_scope(), topdog_fw_image);
+		image->extents = wmem_tree_new(wmem_file_scope());
+		if (usb_conv_info != NULL) {
+			image->bus_id = usb_conv_info->bus_id;
+			image->device_address = usb_conv_info->device_address;
+		}
+		dev->fw_image = image;
+	}
+
+	if (!image->discarded && topdog_max_fw_image_kb != 0
+		&& image->num_bytes + data_size > (guint64)topdog_max_fw_image_kb * 1024) {
+		wmem_tree_foreach(image->extents, free_fw_extent, NULL);
+		image->discarded = TRUE;
+		info->evictions += image->num_chunks;
+	}
+
+	if (image->discarded) {
+		info->evicted = TRUE;
+	} else if (data_size != 0) {
+		topdog_fw_extent *extent = wmem_new(wmem_file_scope(), topdog_fw_extent);
+
+		extent->addr = info->fw_dest_addr;
+		extent->len = data_size;
+		extent->data = (const guint8 *)wmem_memdup(wmem_file_scope(), tvb_get_ptr(tvb, TOPDOG_FW_HEADER_LEN, data_size), data_size);
+		wmem_tree_insert32(image->extents, info->fw_dest_addr, extent);
+		image->num_chunks++;
+		image->num_bytes += data_size;
+	}
+
+	if (info->pdu_type != TOPDOG_FW_SET_AND_EXECUTE)
+		return;
+
+	image->entry_addr = info->fw_dest_addr;
+	dev->fw_image = NULL;
+	if (!image->discarded)
+		info->fw_image = image;
+}
+
+static void unlink_pending_cmd(topdog_dev_info *dev, topdog_pending *pending)
+{
+	if (pending->prev != NULL)
+		pending->prev->next = pending->next;
+	else
+		dev->oldest_cmd = pending->next;
+	if (pending->next != NULL)
+		pending->next->prev = pending->prev;
+	else
+		dev->newest_cmd = pending->prev;
+
+	wmem_map_remove(dev->pending_cmds, GUINT_TO_POINTER(pending->key));
+	dev->num_pending_cmds--;
+}
+
+/* Pairs an MCBW with the MCSW carrying the same tag and sequence number.
+** Outstanding commands are kept in age order; past topdog_max_pending_cmds
+** the oldest is dropped and counts as evicted rather than unanswered. */
+static void match_cmd(topdog_frame_info *info, packet_info *pinfo, usb_conv_info_t *usb_conv_info)
+{
+	topdog_dev_info *dev = get_dev_info(usb_conv_info);
+	guint32 key = TOPDOG_CMD_KEY(info->tag, info->seq_num);
+	topdog_pending *pending;
+
+	pending = (topdog_pending *)wmem_map_lookup(dev->pending_cmds, GUINT_TO_POINTER(key));
+	if (pending != NULL)
+		unlink_pending_cmd(dev, pending);
+
+	if (info->pdu_type == TOPDOG_PDU_MCBW) {
+		if (pending != NULL)
+			wmem_free(wmem_file_scope(), pending);
+
+		pending = wmem_new(wmem_file_scope(), topdog_pending);
+		pending->info = info;
+		pending->frame = pinfo->num;
+		pending->ts = pinfo->abs_ts;
+		pending->key = key;
+		pending->prev = dev->newest_cmd;
+		pending->next = NULL;
+		if (dev->newest_cmd != NULL)
+			dev->newest_cmd->next = pending;
+		else
+			dev->oldest_cmd = pending;
+		dev->newest_cmd = pending;
+		wmem_map_insert(dev->pending_cmds, GUINT_TO_POINTER(key), pending);
+		dev->num_pending_cmds++;
+
+		while (topdog_max_pending_cmds != 0 && dev->num_pending_cmds > topdog_max_pending_cmds) {
+			topdog_pending *oldest = dev->oldest_cmd;
+
+			unlink_pending_cmd(dev, oldest);
+			oldest->info->evicted = TRUE;
+			info->evictions++;
+			wmem_free(wmem_file_scope(), oldest);
+		}
+		return;
+	}
+
+	if (pending == NULL)
+		return;
+
+	pending->info->peer_frame = pinfo->num;
+	info->peer_frame = pending->frame;
+	nstime_delta(&info->rtt, &pinfo->abs_ts, &pending->ts);
+	wmem_free(wmem_file_scope(), pending);
+}
+
+/* Returns how many bytes the PDU at the start of tvb needs, as far as its
+** headers and next pointers tell; 0 if that isn't known. A descriptor chain
+** is followed only as far as the data at hand, so the result may grow as
+** more of the PDU arrives. */
+static guint32 topdog_pdu_needed(tvbuff_t *tvb)
+{
+	guint32 pdu_type, offset = 0, needed = 0, hops = 0;
+	gboolean bad;
+
+	if (!tvb_bytes_exist(tvb, 0, 4))
+		return 0;
+
+	pdu_type = tvb_get_letohl(tvb, 0);
+	switch (pdu_type) {
+	case TOPDOG_FW_SET: case TOPDOG_FW_SET_AND_EXECUTE:
+		return tvb_bytes_exist(tvb, TOPDOG_FW_DATA_SIZE, 4)
+			? MIN(tvb_get_letohl(tvb, TOPDOG_FW_DATA_SIZE), G_MAXUINT32 - TOPDOG_FW_HEADER_LEN - TOPDOG_FW_CRC_LEN)
+				+ TOPDOG_FW_HEADER_LEN + TOPDOG_FW_CRC_LEN
+			: TOPDOG_FW_HEADER_LEN + TOPDOG_FW_CRC_LEN;
+	case TOPDOG_PDU_MCBW: case TOPDOG_PDU_MCSW:
+		/* The command length counts from the command code on. */
+		return tvb_bytes_exist(tvb, TOPDOG_CMD_LEN, 2)
+			? TOPDOG_CMD_CODE + tvb_get_letohs(tvb, TOPDOG_CMD_LEN) : TOPDOG_CMD_LEN + 2;
+	case TOPDOG_PDU_MTXD: case TOPDOG_PDU_MRXD:
+		do {
+			guint32 header_len, pkt_len, next_ptr;
+
+			if (tvb_bytes_exist(tvb, offset, 4))
+				pdu_type = tvb_get_letohl(tvb, offset);
+			if (pdu_type != TOPDOG_PDU_MTXD && pdu_type != TOPDOG_PDU_MRXD)
+				break;
+			header_len = TOPDOG_DESC_HEADER_LEN(pdu_type);
+			if (!tvb_bytes_exist(tvb, offset, header_len))
+				return MAX(needed, offset + header_len);
+			topdog_desc_lengths(tvb_get_ptr(tvb, offset, header_len), pdu_type, &pkt_len, &next_ptr);
+			needed = MAX(needed, offset + header_len + pkt_len);
+			if (!topdog_chain_advance(&offset, next_ptr, &bad))
+				break;
+		} while (++hops < TOPDOG_MAX_CHAIN_HOPS);
+		return needed;
+	}
+
+	return 0;
+}
+
+static void reasm_append(topdog_reasm_pdu *pdu, tvbuff_t *tvb)
+{
+	guint32 len = tvb_captured_length(tvb);
+
+	if (pdu->len + len > pdu->alloc) {
+		while (pdu->len + len > pdu->alloc)
+			pdu->alloc *= 2;
+		pdu->data = (guint8 *)wmem_realloc(wmem_file_scope(), pdu->data, pdu->alloc);
+	}
+	tvb_memcpy(tvb, pdu->data + pdu->len, 0, len);
+	pdu->len += len;
+	pdu->num_fragments++;
+}
+
+/* First pass only. Returns the PDU this transfer is part of, or NULL if it
+** stands alone. Fragments must be fully captured; a gap, an oversized PDU or
+** a transfer that starts a new TopDog PDU abandons the one in progress. */
+static topdog_reasm_pdu *reassemble(tvbuff_t *tvb, packet_info *pinfo, usb_conv_info_t *usb_conv_info)
+{
+	topdog_dev_info *dev = get_dev_info(usb_conv_info);
+	guint32 len = tvb_reported_length(tvb);
+	gboolean complete = tvb_captured_length(tvb) == len;
+	topdog_reasm_pdu **slot;
+	topdog_reasm_pdu *pdu;
+	guint32 needed;
+
+	slot = &dev->reasm[usb_conv_info == NULL ? 0 : (usb_conv_info->endpoint & 0x0f)
+		| (usb_conv_info->direction == P2P_DIR_RECV ? 0x10 : 0)];
+
+	if (*slot != NULL && len != 0) {
+		guint32 magic = tvb_bytes_exist(tvb, 0, 4) ? tvb_get_letohl(tvb, 0) : 0;
+		gboolean restart = (magic == TOPDOG_PDU_MTXD || magic == TOPDOG_PDU_MRXD
+			|| magic == TOPDOG_PDU_MCBW || magic == TOPDOG_PDU_MCSW) && topdog_pdu_needed(tvb) <= len;
+
+		pdu = *slot;
+		if (!complete || restart) {
+			pdu->abandoned = TRUE;
+			*slot = NULL;
+		} else {
+			reasm_append(pdu, tvb);
+			needed = topdog_pdu_needed(tvb_new_child_real_data(tvb, pdu->data, pdu->len, pdu->len));
+			if (needed <= pdu->len) {
+				pdu->last_frame = pinfo->num;
+				*slot = NULL;
+			} else if (needed > TOPDOG_MAX_PDU_LEN) {
+				pdu->abandoned = TRUE;
+				*slot = NULL;
+			}
+			return pdu;
+		}
+	}
+
+	needed = topdog_pdu_needed(tvb);
+	if (!complete || needed <= len || needed > TOPDOG_MAX_PDU_LEN)
+		return NULL;
+
+	pdu = wmem_new0(wmem_file_scope(), topdog_reasm_pdu);
+	pdu->first_frame = pinfo->num;
+	pdu->alloc = needed;
+	pdu->data = (guint8 *)wmem_alloc(wmem_file_scope(), pdu->alloc);
+	reasm_append(pdu, tvb);
+	*slot = pdu;
+	return pdu;
+}
+
+static gboolean tx_ring_release(topdog_tx_ring *ring, guint32 pkt_ptr)
+{
+	guint32 slot = GPOINTER_TO_UINT(wmem_map_remove(ring->slots, GUINT_TO_POINTER(pkt_ptr)));
+
+	if (slot == 0)
+		return FALSE;
+	ring->ptrs[slot - 1] = 0;
+	ring->live--;
+	return TRUE;
+}
+
+/* Moves the live entries to the front of the FIFO, dropping released ones.
+** The window may wrap, so it is copied out before ptrs is rewritten. */
+static void tx_ring_compact(topdog_tx_ring *ring)
+{
+	guint32 *window = (guint32 *)wmem_alloc(wmem_packet_scope(), ring->used * sizeof(guint32));
+	guint32 i, n = 0;
+
+	for (i = 0; i < ring->used; i++) {
+		guint32 pkt_ptr = ring->ptrs[(ring->head + i) % ring->size];
+
+		if (pkt_ptr != 0)
+			window[n++] = pkt_ptr;
+	}
+	memcpy(ring->ptrs, window, n * sizeof(guint32));
+	for (i = 0; i < n; i++)
+		wmem_map_insert(ring->slots, GUINT_TO_POINTER(ring->ptrs[i]), GUINT_TO_POINTER(i + 1));
+	memset(ring->ptrs + n, 0, (ring->size - n) * sizeof(guint32));
+	ring->head = 0;
+	ring->used = n;
+}
+
+/* Updates the TX ring state for one WCB and records the result in desc. WCBs
+** going to the device take a slot; ones coming back release theirs. */
+static void track_tx_ring(topdog_dev_info *dev, topdog_desc *desc, guint8 tx_pri, guint32 pkt_ptr, gboolean submit)
+{
+	topdog_tx_ring *ring;
+	guint32 size = dev->tx_ring_size ? dev->tx_ring_size : TOPDOG_DEFAULT_TX_RING;
+
+	if (tx_pri >= TOPDOG_NUM_TX_PRI || pkt_ptr == 0)
+		return;
+
+	ring = &dev->tx_rings[tx_pri];
+	if (ring->size != size) {
+		memset(ring, 0, sizeof *ring);
+		ring->size = size;
+		ring->ptrs = (guint32 *)wmem_alloc0(wmem_file_scope(), size * sizeof(guint32));
+		ring->slots = wmem_map_new(wmem_file_scope(), g_direct_hash, g_direct_equal);
+	}
+
+	/* A WCB coming back, or a buffer being reused, means the device is done with it. */
+	if (tx_ring_release(ring, pkt_ptr))
+		ring->recycled = TRUE;
+
+	desc->ring_full = FALSE;
+	if (submit) {
+		while (ring->used != 0 && ring->ptrs[ring->head] == 0) {
+			ring->head = (ring->head + 1) % size;
+			ring->used--;
+		}
+		if (ring->live == size) {
+			tx_ring_release(ring, ring->ptrs[ring->head]);
+			ring->head = (ring->head + 1) % size;
+			ring->used--;
+			desc->ring_full = ring->recycled;
+		} else if (ring->used == size) {
+			tx_ring_compact(ring);
+		}
+
+		ring->ptrs[(ring->head + ring->used) % size] = pkt_ptr;
+		ring->used++;
+		wmem_map_insert(ring->slots, GUINT_TO_POINTER(pkt_ptr), GUINT_TO_POINTER((ring->head + ring->used - 1) % size + 1));
+		ring->live++;
+		if (ring->live > ring->high_water)
+			ring->high_water = ring->live;
+	}
+
+	desc->ring_tracked = TRUE;
+	desc->ring_occupancy = ring->live;
+	desc->ring_high_water = ring->high_water;
+	desc->ring_size = size;
+}
+
+static topdog_frame_info *get_frame_info(tvbuff_t *tvb, packet_info *pinfo, usb_conv_info_t *usb_conv_info)
+{
+	topdog_frame_info *info;
+
+	info = (topdog_frame_info *)p_get_proto_data(wmem_file_scope(), pinfo, proto_topdog, 0);
+	if (info != NULL)
+		return info;
+
+	info = wmem_new0(wmem_file_scope(), topdog_frame_info);
+	info->dev_key = topdog_dev_key(usb_conv_info);
+	info->reasm = reassemble(tvb, pinfo, usb_conv_info);
+	if (info->reasm != NULL) {
+		if (info->reasm->last_frame != pinfo->num) {
+			/* Keep the layout of a first fragment, in case the PDU is
+			** abandoned and the frame has to be shown on its own. */
+			if (info->reasm->first_frame == pinfo->num) {
+				cache_chain(tvb, info);
+				if (info->chain_count != 0)
+					info->pdu_type = info->descs[0].pdu_type;
+			}
+			p_add_proto_data(wmem_file_scope(), pinfo, proto_topdog, 0, info);
+			return info;
+		}
+		tvb = tvb_new_child_real_data(tvb, info->reasm->data, info->reasm->len, info->reasm->len);
+	}
+	cache_chain(tvb, info);
+	if (info->chain_count != 0)
+		info->pdu_type = info->descs[0].pdu_type;
+
+	switch (info->pdu_type) {
+	case TOPDOG_FW_RESPONSE:
+		if (tvb_bytes_exist(tvb, TOPDOG_FW_SEQ_NUM, 4)) {
+			topdog_dev_info *dev = get_dev_info(usb_conv_info);
+
+			info->seq_num = tvb_get_letohl(tvb, TOPDOG_FW_SEQ_NUM);
+
+			/* The download is stop-and-wait: a response acks the last chunk. */
+			if (dev->fw_pending.info != NULL) {
+				dev->fw_pending.info->peer_frame = pinfo->num;
+				info->peer_frame = dev->fw_pending.frame;
+				nstime_delta(&info->rtt, &pinfo->abs_ts, &dev->fw_pending.ts);
+				dev->fw_pending.info = NULL;
+			}
+		}
+		break;
+	case TOPDOG_FW_SET: case TOPDOG_FW_SET_AND_EXECUTE:
+		if (tvb_bytes_exist(tvb, TOPDOG_FW_DEST_ADDR, 8)) {
+			guint32 data_size = tvb_get_letohl(tvb, TOPDOG_FW_DATA_SIZE);
+			topdog_dev_info *dev = get_dev_info(usb_conv_info);
+
+			info->fw_dest_addr = tvb_get_letohl(tvb, TOPDOG_FW_DEST_ADDR);
+			info->fw_data_size = data_size;
+			dev->fw_pending.info = info;
+			dev->fw_pending.frame = pinfo->num;
+			dev->fw_pending.ts = pinfo->abs_ts;
+
+			if (data_size <= G_MAXINT - TOPDOG_FW_HEADER_LEN - TOPDOG_FW_CRC_LEN
+				&& tvb_bytes_exist(tvb, 0, TOPDOG_FW_HEADER_LEN + data_size)) {
+				info->fw_header_crc = crc32_slice8(tvb_get_ptr(tvb, 0, TOPDOG_FW_HEADER_CRC), TOPDOG_FW_HEADER_CRC);
+				info->fw_data_crc = crc32_slice8(tvb_get_ptr(tvb, TOPDOG_FW_HEADER_LEN, data_size), data_size);
+				info->fw_crc_computed = TRUE;
+				add_fw_chunk(tvb, info, usb_conv_info);
+			}
+		}
+		break;
+	case TOPDOG_PDU_MCBW: case TOPDOG_PDU_MCSW:
+		if (tvb_bytes_exist(tvb, 0, TOPDOG_CMD_HEADER_LEN)) {
+			info->tag = tvb_get_letohs(tvb, TOPDOG_CMD_TAG);
+			info->cmd = tvb_get_letohs(tvb, TOPDOG_CMD_CODE);
+			info->seq_num = tvb_get_letohs(tvb, TOPDOG_CMD_SEQ_NUM);
+			match_cmd(info, pinfo, usb_conv_info);
+		}
+		/* GET_HW_SPEC response: num_tx_desc_per_queue sizes the TX rings. */
+		if (info->cmd == (0x0003 | TOPDOG_CMD_RESPONSE) && tvb_bytes_exist(tvb, TOPDOG_CMD_HEADER_LEN+68, 4)) {
+			guint32 ring_size = tvb_get_letohl(tvb, TOPDOG_CMD_HEADER_LEN+68);
+
+			if (ring_size != 0 && ring_size <= TOPDOG_MAX_TX_RING)
+				get_dev_info(usb_conv_info)->tx_ring_size = ring_size;
+		}
+		if ((info->cmd == 0x001d || info->cmd == 0x010a) && tvb_bytes_exist(tvb, TOPDOG_CMD_HEADER_LEN+2, 1))
+			info->rf_channel = tvb_get_guint8(tvb, TOPDOG_CMD_HEADER_LEN+2);
+		break;
+	case TOPDOG_PDU_MTXD: {
+		topdog_dev_info *dev = get_dev_info(usb_conv_info);
+		gboolean submit = usb_conv_info == NULL || usb_conv_info->direction != P2P_DIR_RECV;
+		guint32 i;
+
+		for (i = 0; i < info->chain_count; i++) {
+			guint32 offset = info->descs[i].offset;
+
+			if (info->descs[i].pdu_type == TOPDOG_PDU_MTXD
+				&& tvb_bytes_exist(tvb, offset, TOPDOG_WCB_PKT_PTR + 4))
+				track_tx_ring(dev, &info->descs[i], tvb_get_guint8(tvb, offset+TOPDOG_WCB_TX_PRI),
+					tvb_get_letohl(tvb, offset+TOPDOG_WCB_PKT_PTR), submit);
+		}
+		break;
+	}
+	}
+
+	p_add_proto_data(wmem_file_scope(), pinfo, proto_topdog, 0, info);
+	return info;
+}
+
+static void set_info_column(packet_info *pinfo, const topdog_frame_info *info)
+{
+	if (info->chain_count == 0) {
+		col_set_str(pinfo->cinfo, COL_INFO, "Truncated");
+		return;
+	}
+
+	col_add_str(pinfo->cinfo, COL_INFO, val_to_str(info->pdu_type, topdog_types, "Unknown (0x%08x)"));
+
+	switch (info->pdu_type) {
+	case TOPDOG_FW_RESPONSE:
+		col_append_fstr(pinfo->cinfo, COL_INFO, ", Seq=0x%x", info->seq_num);
+		break;
+	case TOPDOG_PDU_MCBW: case TOPDOG_PDU_MCSW:
+		if (cmd_name(info->cmd) != NULL)
+			col_append_fstr(pinfo->cinfo, COL_INFO, " %s, Seq=0x%04x", cmd_name(info->cmd), info->seq_num);
+		else
+			col_append_fstr(pinfo->cinfo, COL_INFO, " Unknown command (0x%04x), Seq=0x%04x",
+				info->cmd, info->seq_num);
+		break;
+	case TOPDOG_PDU_MTXD: case TOPDOG_PDU_MRXD:
+		col_append_fstr(pinfo->cinfo, COL_INFO, " (%u descriptor%s)",
+			info->chain_count, info->chain_count == 1 ? "" : "s");
+		break;
+	}
+
+	if (info->truncated)
+		col_append_str(pinfo->cinfo, COL_INFO, " [truncated]");
+}
+
+/* A transfer that only carries part of a PDU. */
+static void dissect_fragment(tvbuff_t *tvb, packet_info *pinfo, proto_tree *tree, const topdog_reasm_pdu *pdu)
+{
+	if (pdu->last_frame != 0)
+		col_add_fstr(pinfo->cinfo, COL_INFO, "Fragment, reassembled in #%u", pdu->last_frame);
+	else if (pdu->abandoned)
+		col_set_str(pinfo->cinfo, COL_INFO, "Fragment, not reassembled");
+	else
+		col_set_str(pinfo->cinfo, COL_INFO, "Fragment");
+
+	if (tree) {
+		proto_item *topdog_item;
+		proto_tree *topdog_tree;
+		proto_item *item;
+
+		topdog_item = proto_tree_add_item(tree, proto_topdog, tvb, 0, -1, ENC_NA);
+		topdog_tree = proto_item_add_subtree(topdog_item, ett_topdog);
+		if (pdu->last_frame != 0) {
+			item = proto_tree_add_uint(topdog_tree, hf_reassembled_in, tvb, 0, 0, pdu->last_frame);
+			PROTO_ITEM_SET_GENERATED(item);
+		}
+		item = proto_tree_add_uint(topdog_tree, hf_fragment_first, tvb, 0, 0, pdu->first_frame);
+		PROTO_ITEM_SET_GENERATED(item);
+	}
+}
+
+static void add_reassembly_fields(proto_tree *tree, tvbuff_t *tvb, const topdog_reasm_pdu *pdu)
+{
+	proto_item *item;
+
+	item = proto_tree_add_uint(tree, hf_fragment_first, tvb, 0, 0, pdu->first_frame);
+	PROTO_ITEM_SET_GENERATED(item);
+	item = proto_tree_add_uint(tree, hf_fragment_count, tvb, 0, 0, pdu->num_fragments);
+	PROTO_ITEM_SET_GENERATED(item);
+	item = proto_tree_add_uint(tree, hf_reassembled_len, tvb, 0, 0, pdu->len);
+	PROTO_ITEM_SET_GENERATED(item);
+}
+
+static int dissect_topdog(tvbuff_t *tvb, packet_info *pinfo,
+	proto_tree *tree, void *data)
+{
+	topdog_frame_info *info;
+
+	col_set_str(pinfo->cinfo, COL_PROTOCOL, "TOPDOG");
+
+	/* Everything up to here runs without a tree, so first-pass runs and taps
+	** still get the info column and the per-frame summary. */
+	info = get_frame_info(tvb, pinfo, (usb_conv_info_t *)data);
+
+	if (info->reasm != NULL) {
+		if (info->reasm->last_frame == pinfo->num) {
+			tvb = tvb_new_child_real_data(tvb, info->reasm->data, info->reasm->len, info->reasm->len);
+			add_new_data_source(pinfo, tvb, "Reassembled TopDog");
+		} else if (!info->reasm->abandoned || info->reasm->first_frame != pinfo->num) {
+			dissect_fragment(tvb, pinfo, tree, info->reasm);
+			return tvb_captured_length(tvb);
+		}
+	}
+
+	set_info_column(pinfo, info);
+
+	tap_queue_packet(topdog_tap, pinfo, info);
+	if (info->pdu_type == TOPDOG_PDU_MRXD || info->pdu_type == TOPDOG_PDU_MTXD)
+		queue_desc_infos(tvb, pinfo, info);
+	if (info->fw_image != NULL)
+		tap_queue_packet(topdog_eo_tap, pinfo, info->fw_image);
+
+	if (tree) {
+		proto_item *topdog_item = NULL;
+		proto_tree *topdog_tree = NULL;
+
+		topdog_item = proto_tree_add_item(tree, proto_topdog, tvb, 0, -1, ENC_NA);
+		topdog_tree = proto_item_add_subtree(topdog_item, ett_topdog);
+
+		if (info->reasm != NULL && info->reasm->last_frame == pinfo->num)
+			add_reassembly_fields(topdog_tree, tvb, info->reasm);
+		dissect_pdu(topdog_tree, tvb, pinfo, info);
+		if (info->truncated)
+			proto_tree_add_expert(topdog_tree, pinfo, &ei_truncated, tvb, 0, 0);
+
+		if (info->evictions != 0)
+			proto_tree_add_expert_format(topdog_tree, pinfo, &ei_state_evicted, tvb, 0, 0,
+				"%u tracked entries evicted: state table limit reached", info->evictions);
+	}
+
+	return tvb_captured_length(tvb);
+}
+
+/* FW_RESPONSE (8 bytes), or the header of an FW_SET or FW_SET_AND_EXECUTE
+** chunk that is no longer than its PDU. The magics are not probed for, as
+** too much unrelated traffic starts with them. */
+static gboolean topdog_heur_fw_like(tvbuff_t *tvb)
+{
+	guint32 len = tvb_captured_length(tvb);
+
+	if (len < TOPDOG_FW_RESPONSE_LEN)
+		return FALSE;
+
+	switch (tvb_get_letohl(tvb, 0)) {
+	case TOPDOG_FW_RESPONSE:
+		return tvb_reported_length(tvb) == TOPDOG_FW_RESPONSE_LEN;
+	case TOPDOG_FW_SET: case TOPDOG_FW_SET_AND_EXECUTE:
+		return len >= TOPDOG_FW_DATA_SIZE + 4 && tvb_get_letohl(tvb, TOPDOG_FW_DATA_SIZE) <= 0x10000
+			&& tvb_reported_length(tvb) <= tvb_get_letohl(tvb, TOPDOG_FW_DATA_SIZE)
+				+ TOPDOG_FW_HEADER_LEN + TOPDOG_FW_CRC_LEN;
+	}
+	return FALSE;
+}
+
+/* usb.product hands over every transfer of the device; TopDog is on the bulk
+** endpoints only, so control and interrupt transfers are left to others. */
+static int dissect_topdog_product(tvbuff_t *tvb, packet_info *pinfo,
+	proto_tree *tree, void *data)
+{
+	usb_conv_info_t *usb_conv_info = (usb_conv_info_t *)data;
+
+	if (usb_conv_info == NULL || usb_conv_info->transfer_type != URB_BULK)
+		return 0;
+	return dissect_topdog(tvb, pinfo, tree, data);
+}
+
+static topdog_heur_state *new_heur_state(usb_conv_info_t *usb_conv_info)
+{
+	topdog_heur_state *state = wmem_new0(wmem_file_scope(), topdog_heur_state);
+
+	wmem_map_insert(topdog_heur_states, GUINT_TO_POINTER(TOPDOG_HEUR_KEY(usb_conv_info)), state);
+	return state;
+}
+
+static gboolean
+dissect_topdog_bulk_heur(tvbuff_t *tvb, packet_info *pinfo, proto_tree *tree, void *data)
+{
+	usb_conv_info_t *usb_conv_info = (usb_conv_info_t *)data;
+	topdog_heur_state *state = NULL;
+
+	if (usb_conv_info != NULL
+		&& g_hash_table_contains(topdog_products, GUINT_TO_POINTER(TOPDOG_USB_PRODUCT(
+			usb_conv_info->deviceVendor, usb_conv_info->deviceProduct)))) {
+		dissect_topdog(tvb, pinfo, tree, data);
+		return TRUE;
+	}
+
+	/* packet-usb doesn't hand bulk payloads to conversation dissectors, so
+	** every transfer comes through here; the verdict only short-circuits
+	** the probe. */
+	if (usb_conv_info != NULL)
+		state = (topdog_heur_state *)wmem_map_lookup(topdog_heur_states,
+			GUINT_TO_POINTER(TOPDOG_HEUR_KEY(usb_conv_info)));
+	if (state != NULL) {
+		if (state->pinned_in != 0 && pinfo->num >= state->pinned_in) {
+			dissect_topdog(tvb, pinfo, tree, data);
+			return TRUE;
+		}
+		if (state->rejected_in != 0 && pinfo->num >= state->rejected_in)
+			return FALSE;
+	}
+
+	if (tvb_captured_length(tvb) >= 4) {
+		switch (tvb_get_letohl(tvb, 0)) {
+		case TOPDOG_PDU_MCBW: case TOPDOG_PDU_MCSW: case TOPDOG_PDU_MTXD: case TOPDOG_PDU_MRXD:
+			if (usb_conv_info != NULL) {
+				if (state == NULL)
+					state = new_heur_state(usb_conv_info);
+				if (state->pinned_in == 0)
+					state->pinned_in = pinfo->num;
+			}
+			dissect_topdog(tvb, pinfo, tree, data);
+			return TRUE;
+		}
+	}
+
+	if (usb_conv_info == NULL || PINFO_FD_VISITED(pinfo) || topdog_heur_fw_like(tvb))
+		return FALSE;
+	if (state == NULL)
+		state = new_heur_state(usb_conv_info);
+	if (++state->misses == TOPDOG_HEUR_MISS_LIMIT)
+		state->rejected_in = pinfo->num + 1;
+
+	return FALSE;
+}
+
+static gboolean collect_fw_extent(const void *key, void *value, void *userdata)
+{
+	g_ptr_array_add((GPtrArray *)userdata, value);
+	return FALSE;
+}
+
+/* Exports a finished firmware image, one object per contiguous address run. */
+static gboolean
+topdog_eo_packet(void *tapdata, packet_info *pinfo, epan_dissect_t *edt, const void *data)
+{
+	export_object_list_t *object_list = (export_object_list_t *)tapdata;
+	const topdog_fw_image *image = (const topdog_fw_image *)data;
+	GPtrArray *extents = g_ptr_array_new();
+	guint first = 0, i, j;
+
+	wmem_tree_foreach(image->extents, collect_fw_extent, extents);
+
+	while (first < extents->len) {
+		const topdog_fw_extent *extent = (const topdog_fw_extent *)g_ptr_array_index(extents, first);
+		guint32 run_start = extent->addr;
+		guint64 run_end = (guint64)extent->addr + extent->len;
+		export_object_entry_t *entry;
+
+		for (i = first + 1; i < extents->len; i++) {
+			extent = (const topdog_fw_extent *)g_ptr_array_index(extents, i);
+			if (extent->addr > run_end)
+				break;
+			run_end = MAX(run_end, (guint64)extent->addr + extent->len);
+		}
+
+		entry = g_new0(export_object_entry_t, 1);
+		entry->pkt_num = pinfo->num;
+		entry->hostname = g_strdup_printf("usb %u.%u", image->bus_id, image->device_address);
+		entry->content_type = g_strdup("application/octet-stream");
+		entry->filename = g_strdup_printf("topdog_fw_%08x.bin", run_start);
+		entry->payload_len = run_end - run_start;
+		entry->payload_data = (guint8 *)g_malloc(entry->payload_len);
+
+		/* Extents are copied in address order; where two overlap, the
+		** higher one wins. */
+		for (j = first; j < i; j++) {
+			extent = (const topdog_fw_extent *)g_ptr_array_index(extents, j);
+			memcpy(entry->payload_data + (extent->addr - run_start), extent->data, extent->len);
+		}
+
+		object_list->add_entry(object_list->gui_data, entry);
+		first = i;
+	}
+
+	g_ptr_array_free(extents, TRUE);
+	return TRUE;
+}
+
+/* -z topdog,fwload[,filter]
+** Firmware download timeline, one per device. Round-trip time (chunk to
+** FW_RESPONSE) is spent in the device; the gap (FW_RESPONSE to next chunk)
+** is spent in the host. Chunks carry no sequence number for the response's
+** to echo, so a response is paired with the device's last outstanding chunk
+** (the download is stop-and-wait), not by topdog.fw.seq_num. */
+#define TOPDOG_FW_STALL_MS 50.0
+
+typedef struct _fwload_chunk {
+	guint32 frame;
+	guint32 dest_addr;
+	guint32 data_size;
+	double ts;
+	double rtt_ms;	/* < 0 if unanswered */
+	double gap_ms;	/* < 0 for the first chunk */
+} fwload_chunk;
+
+typedef struct _fwload_device {
+	guint32 key;	/* bus << 16 | device address */
+	GArray *chunks;	/* fwload_chunk, in capture order */
+	guint pending;	/* index + 1 of the chunk awaiting a response, 0 if none */
+	double first_ts;
+	double last_response_ts;
+	double execute_ts;
+	guint32 execute_frame;
+	guint64 bytes;
+} fwload_device;
+
+typedef struct _fwload_stats {
+	char *filter;
+	GHashTable *devices;	/* fwload_device, keyed by key */
+} fwload_stats;
+
+static void fwload_device_free(gpointer data)
+{
+	fwload_device *dev = (fwload_device *)data;
+
+	g_array_free(dev->chunks, TRUE);
+	g_free(dev);
+}
+
+static void fwload_reset(void *tapdata)
+{
+	fwload_stats *stats = (fwload_stats *)tapdata;
+
+	g_hash_table_remove_all(stats->devices);
+}
+
+static gboolean fwload_packet(void *tapdata, packet_info *pinfo, epan_dissect_t *edt, const void *data)
+{
+	fwload_stats *stats = (fwload_stats *)tapdata;
+	const topdog_frame_info *info = (const topdog_frame_info *)data;
+	double ts = nstime_to_sec(&pinfo->abs_ts);
+	fwload_device *dev;
+	fwload_chunk chunk;
+
+	if (info->pdu_type != TOPDOG_FW_RESPONSE && info->pdu_type != TOPDOG_FW_SET
+		&& info->pdu_type != TOPDOG_FW_SET_AND_EXECUTE)
+		return FALSE;
+
+	dev = (fwload_device *)g_hash_table_lookup(stats->devices, GUINT_TO_POINTER(info->dev_key));
+	if (dev == NULL) {
+		dev = g_new0(fwload_device, 1);
+		dev->key = info->dev_key;
+		dev->chunks = g_array_new(FALSE, FALSE, sizeof(fwload_chunk));
+		dev->first_ts = dev->last_response_ts = dev->execute_ts = -1;
+		g_hash_table_insert(stats->devices, GUINT_TO_POINTER(dev->key), dev);
+	}
+
+	/* The RTT is known on the response only, even in single-pass tshark. */
+	if (info->pdu_type == TOPDOG_FW_RESPONSE) {
+		fwload_chunk *pending;
+
+		if (info->peer_frame == 0 || dev->pending == 0)
+			return FALSE;
+		pending = &g_array_index(dev->chunks, fwload_chunk, dev->pending - 1);
+		if (pending->frame != info->peer_frame)
+			return FALSE;
+		pending->rtt_ms = nstime_to_msec(&info->rtt);
+		dev->pending = 0;
+		dev->last_response_ts = ts;
+		return TRUE;
+	}
+
+	chunk.frame = pinfo->num;
+	chunk.dest_addr = info->fw_dest_addr;
+	chunk.data_size = info->fw_data_size;
+	chunk.ts = ts;
+	chunk.rtt_ms = -1;
+	chunk.gap_ms = dev->last_response_ts >= 0 ? (ts - dev->last_response_ts) * 1000 : -1;
+	g_array_append_val(dev->chunks, chunk);
+	dev->pending = dev->chunks->len;
+
+	if (dev->first_ts < 0)
+		dev->first_ts = ts;
+	dev->bytes += info->fw_data_size;
+	if (info->pdu_type == TOPDOG_FW_SET_AND_EXECUTE) {
+		dev->execute_ts = ts;
+		dev->execute_frame = pinfo->num;
+	}
+
+	return TRUE;
+}
+
+static gint fwload_compare(gconstpointer a, gconstpointer b)
+{
+	const fwload_device *da = (const fwload_device *)a;
+	const fwload_device *db = (const fwload_device *)b;
+
+	return da->key < db->key ? -1 : da->key > db->key;
+}
+
+static void fwload_draw_device(const fwload_device *dev)
+{
+	double rtt_sum = 0, rtt_min = 0, rtt_max = 0, gap_sum = 0, elapsed;
+	guint32 answered = 0, stalls = 0;
+	guint i;
+
+	printf("Device %u.%u\n", dev->key >> 16, dev->key & 0xffff);
+	printf("Chunk   Frame      Address      Size    Time (s)   RTT (ms)   Gap (ms)\n");
+
+	for (i = 0; i < dev->chunks->len; i++) {
+		const fwload_chunk *chunk = &g_array_index(dev->chunks, fwload_chunk, i);
+		gboolean stall = chunk->rtt_ms > TOPDOG_FW_STALL_MS || chunk->gap_ms > TOPDOG_FW_STALL_MS;
+
+		printf("%5u %7u   0x%08x %8u %11.6f ", i, chunk->frame, chunk->dest_addr,
+			chunk->data_size, chunk->ts - dev->first_ts);
+		if (chunk->rtt_ms >= 0)
+			printf("%10.3f ", chunk->rtt_ms);
+		else
+			printf("%10s ", "-");
+		if (chunk->gap_ms >= 0)
+			printf("%10.3f", chunk->gap_ms);
+		else
+			printf("%10s", "-");
+		printf("%s\n", stall ? "  STALL" : "");
+
+		if (chunk->rtt_ms >= 0) {
+			if (answered == 0 || chunk->rtt_ms < rtt_min)
+				rtt_min = chunk->rtt_ms;
+			if (chunk->rtt_ms > rtt_max)
+				rtt_max = chunk->rtt_ms;
+			rtt_sum += chunk->rtt_ms;
+			answered++;
+		}
+		if (chunk->gap_ms >= 0)
+			gap_sum += chunk->gap_ms;
+		if (stall)
+			stalls++;
+	}
+
+	printf("-------------------------------------------------------------------\n");
+	printf("Chunks: %u (%u answered), %" G_GINT64_MODIFIER "u bytes, %u stalls (> %.0f ms)\n",
+		dev->chunks->len, answered, dev->bytes, stalls, TOPDOG_FW_STALL_MS);
+	if (answered != 0)
+		printf("Device RTT (ms): min %.3f, max %.3f, avg %.3f, total %.3f\n",
+			rtt_min, rtt_max, rtt_sum / answered, rtt_sum);
+	printf("Host gap (ms): total %.3f\n", gap_sum);
+	if (dev->execute_frame != 0) {
+		elapsed = dev->execute_ts - dev->first_ts;
+		printf("FW_SET_AND_EXECUTE in frame %u, %.6f s after the first chunk\n",
+			dev->execute_frame, elapsed);
+		if (elapsed > 0)
+			printf("Throughput: %.0f bytes/s\n", dev->bytes / elapsed);
+	} else {
+		printf("FW_SET_AND_EXECUTE not seen\n");
+	}
+}
+
+static void fwload_draw(void *tapdata)
+{
+	fwload_stats *stats = (fwload_stats *)tapdata;
+	GList *devices = g_list_sort(g_hash_table_get_values(stats->devices), fwload_compare);
+	GList *l;
+
+	printf("\n===================================================================\n");
+	printf("TopDog Firmware Download%s%s\n", stats->filter ? " Filter: " : "", stats->filter ? stats->filter : "");
+	for (l = devices; l != NULL; l = l->next) {
+		const fwload_device *dev = (const fwload_device *)l->data;
+
+		/* Devices seen only through stray responses have no timeline. */
+		if (dev->chunks->len == 0)
+			continue;
+		printf("\n");
+		fwload_draw_device(dev);
+	}
+	printf("===================================================================\n");
+	g_list_free(devices);
+}
+
+static void fwload_init(const char *opt_arg, void *userdata)
+{
+	fwload_stats *stats = g_new0(fwload_stats, 1);
+	GString *error_string;
+
+	if (strncmp(opt_arg, "topdog,fwload,", 14) == 0)
+		stats->filter = g_strdup(opt_arg + 14);
+	stats->devices = g_hash_table_new_full(g_direct_hash, g_direct_equal, NULL, fwload_device_free);
+
+	error_string = register_tap_listener("topdog", stats, stats->filter, 0,
+		fwload_reset, fwload_packet, fwload_draw);
+	if (error_string) {
+		fprintf(stderr, "tshark: Couldn't register topdog,fwload tap: %s\n", error_string->str);
+		g_string_free(error_string, TRUE);
+		g_hash_table_destroy(stats->devices);
+		g_free(stats->filter);
+		g_free(stats);
+		exit(1);
+	}
+}
+
+static stat_tap_ui fwload_ui = {
+	REGISTER_STAT_GROUP_GENERIC,
+	NULL,
+	"topdog,fwload",
+	fwload_init,
+	0,
+	NULL
+};
+
+/* Service Response Time: one row per command slot, so row = slot - 1. */
+static void topdog_srt_init(struct register_srt *srt, GArray *srt_array,
+	srt_gui_init_cb gui_callback, void *gui_data)
+{
+	srt_stat_table *table;
+	guint slot;
+
+	table = init_srt_table("TopDog Commands", NULL, srt_array, num_cmd_slots,
+		"Command", "topdog.cmd", gui_callback, gui_data, NULL);
+
+	for (slot = 1; slot <= num_cmd_slots; slot++) {
+		const char *request_name = cmd_table[slot].request_name;
+		size_t len = request_name ? strlen(request_name) : 0;
+		gchar *name;
+
+		/* Drop the " Request" suffix; name unknown commands by code. */
+		if (len <= 8 || request_name[0] == '?')
+			name = g_strdup_printf("0x%04x", cmd_table[slot].code);
+		else
+			name = g_strndup(request_name, len - 8);
+		init_srt_table_row(table, slot - 1, name);
+		g_free(name);
+	}
+}
+
+static gboolean
+topdog_srt_packet(void *pss, packet_info *pinfo, epan_dissect_t *edt, const void *prv)
+{
+	srt_stat_table *table = g_array_index((GArray *)pss, srt_stat_table *, 0);
+	const topdog_frame_info *info = (const topdog_frame_info *)prv;
+	const topdog_cmd_entry *entry;
+	nstime_t req_time;
+
+	if (info->pdu_type != TOPDOG_PDU_MCSW || info->peer_frame == 0)
+		return FALSE;
+
+	entry = lookup_cmd(info->cmd);
+	if (entry == NULL)
+		return FALSE;
+
+	nstime_delta(&req_time, &pinfo->abs_ts, &info->rtt);
+	add_srt_table_data(table, (int)(entry - cmd_table) - 1, &req_time, pinfo);
+	return TRUE;
+}
+
+/* -z topdog,rxstats[,filter]
+** Radio statistics over all RxPDs. Every histogram is a fixed array, so memory
+** stays constant no matter how many descriptors the capture holds. */
+typedef struct _rxstats_channel {
+	guint64 count;
+	guint64 rssi[256];
+	guint64 snr[256];	/* SNR in dB, offset by 128 */
+} rxstats_channel;
+
+typedef struct _rxstats_stats {
+	char *filter;
+	guint64 count;
+	rxstats_channel *channels[256];	/* allocated on first use */
+	guint64 ht[2];
+	guint64 mcs[64];	/* HT frames only */
+	guint64 bw40[2];
+	guint64 short_gi[2];
+	guint64 ant[4];
+} rxstats_stats;
+
+static void rxstats_reset(void *tapdata)
+{
+	rxstats_stats *stats = (rxstats_stats *)tapdata;
+	char *filter = stats->filter;
+	int i;
+
+	for (i = 0; i < 256; i++)
+		g_free(stats->channels[i]);
+	memset(stats, 0, sizeof *stats);
+	stats->filter = filter;
+}
+
+static gboolean rxstats_packet(void *tapdata, packet_info *pinfo, epan_dissect_t *edt, const void *data)
+{
+	rxstats_stats *stats = (rxstats_stats *)tapdata;
+	const topdog_rx_info *rx = (const topdog_rx_info *)data;
+	rxstats_channel *channel = stats->channels[rx->channel];
+	guint16 rate = rx->rx_rate_info;
+
+	if (channel == NULL)
+		channel = stats->channels[rx->channel] = g_new0(rxstats_channel, 1);
+
+	channel->count++;
+	channel->rssi[rx->rssi]++;
+	/* SNR = signal - noise = (-rssi) - (-noise_lvl) */
+	channel->snr[(guint8)(128 + rx->noise_lvl - rx->rssi)]++;
+
+	stats->count++;
+	stats->ht[TOPDOG_RATE_HT(rate)]++;
+	if (TOPDOG_RATE_HT(rate))
+		stats->mcs[TOPDOG_RATE_MCS(rate)]++;
+	stats->bw40[TOPDOG_RATE_BW40(rate)]++;
+	stats->short_gi[TOPDOG_RATE_SHORT_GI(rate)]++;
+	stats->ant[TOPDOG_RATE_ANT(rate)]++;
+
+	return TRUE;
+}
+
+/* Returns the bin at which the running count reaches frac of total. */
+static int histogram_quantile(const guint64 *bins, int num_bins, guint64 total, double frac)
+{
+	guint64 sum = 0;
+	int i;
+
+	for (i = 0; i < num_bins; i++) {
+		sum += bins[i];
+		if (sum > 0 && sum >= frac * total)
+			return i;
+	}
+
+	return num_bins - 1;
+}
+
+static double percent(guint64 part, guint64 total)
+{
+	return total ? 100.0 * part / total : 0;
+}
+
+static void rxstats_draw(void *tapdata)
+{
+	rxstats_stats *stats = (rxstats_stats *)tapdata;
+	int i;
+
+	printf("\n===================================================================\n");
+	printf("TopDog RX Statistics%s%s\n", stats->filter ? " Filter: " : "", stats->filter ? stats->filter : "");
+	printf("RxPDs: %" G_GINT64_MODIFIER "u\n\n", stats->count);
+
+	printf("Channel      Count   RSSI dBm (p10/p50/p90)    SNR dB (p10/p50/p90)\n");
+	for (i = 0; i < 256; i++) {
+		const rxstats_channel *channel = stats->channels[i];
+
+		if (channel == NULL)
+			continue;
+		/* A larger RSSI magnitude is a weaker signal, so quantiles flip. */
+		printf("%7d %10" G_GINT64_MODIFIER "u   %6d %6d %6d      %6d %6d %6d\n", i, channel->count,
+			-histogram_quantile(channel->rssi, 256, channel->count, 0.9),
+			-histogram_quantile(channel->rssi, 256, channel->count, 0.5),
+			-histogram_quantile(channel->rssi, 256, channel->count, 0.1),
+			histogram_quantile(channel->snr, 256, channel->count, 0.1) - 128,
+			histogram_quantile(channel->snr, 256, channel->count, 0.5) - 128,
+			histogram_quantile(channel->snr, 256, channel->count, 0.9) - 128);
+	}
+
+	printf("\nLegacy: %.1f%%  HT: %.1f%%\n",
+		percent(stats->ht[0], stats->count), percent(stats->ht[1], stats->count));
+	printf("Bandwidth: 20 MHz %.1f%%  40 MHz %.1f%%\n",
+		percent(stats->bw40[0], stats->count), percent(stats->bw40[1], stats->count));
+	printf("Guard interval: long %.1f%%  short %.1f%%\n",
+		percent(stats->short_gi[0], stats->count), percent(stats->short_gi[1], stats->count));
+	printf("Antenna: none %.1f%%  Ant0 %.1f%%  Ant1 %.1f%%  Ant0+Ant1 %.1f%%\n",
+		percent(stats->ant[0], stats->count), percent(stats->ant[1], stats->count),
+		percent(stats->ant[2], stats->count), percent(stats->ant[3], stats->count));
+
+	printf("\nMCS        Count\n");
+	for (i = 0; i < 64; i++)
+		if (stats->mcs[i] != 0)
+			printf("%3d %12" G_GINT64_MODIFIER "u  %5.1f%%\n", i, stats->mcs[i],
+				percent(stats->mcs[i], stats->ht[1]));
+	printf("===================================================================\n");
+}
+
+static void rxstats_init(const char *opt_arg, void *userdata)
+{
+	rxstats_stats *stats = g_new0(rxstats_stats, 1);
+	GString *error_string;
+
+	if (strncmp(opt_arg, "topdog,rxstats,", 15) == 0)
+		stats->filter = g_strdup(opt_arg + 15);
+
+	error_string = register_tap_listener("topdog.rx", stats, stats->filter, 0,
+		rxstats_reset, rxstats_packet, rxstats_draw);
+	if (error_string) {
+		fprintf(stderr, "tshark: Couldn't register topdog,rxstats tap: %s\n", error_string->str);
+		g_string_free(error_string, TRUE);
+		g_free(stats->filter);
+		g_free(stats);
+		exit(1);
+	}
+}
+
+static stat_tap_ui rxstats_ui = {
+	REGISTER_STAT_GROUP_GENERIC,
+	NULL,
+	"topdog,rxstats",
+	rxstats_init,
+	0,
+	NULL
+};
+
+/* -z topdog,urbstats[,filter]
+** Batching efficiency of MTXD/MRXD bulk transfers: descriptors per URB, how
+** transfer bytes split into headers, payload and padding, URB sizes in
+** power-of-two buckets, and a per-second timeline. */
+#define URBSTATS_MAX_DESCS	64	/* last bucket holds 64 or more */
+#define URBSTATS_SIZE_BUCKETS	17	/* < 2, < 4, ... , >= 32768 bytes */
+
+typedef struct _urbstats_dir {
+	guint64 urbs;
+	guint64 descs;
+	guint64 urb_bytes;
+	guint64 payload_bytes;
+	guint64 header_bytes;
+	guint64 padding;
+	guint64 desc_counts[URBSTATS_MAX_DESCS + 1];
+	guint64 sizes[URBSTATS_SIZE_BUCKETS];
+} urbstats_dir;
+
+typedef struct _urbstats_interval {
+	guint64 urbs[2];
+	guint64 urb_bytes[2];
+	guint64 descs[2];
+} urbstats_interval;
+
+typedef struct _urbstats_stats {
+	char *filter;
+	urbstats_dir dirs[2];	/* 0 = RX, 1 = TX */
+	GArray *intervals;	/* urbstats_interval per second of capture */
+} urbstats_stats;
+
+static void urbstats_reset(void *tapdata)
+{
+	urbstats_stats *stats = (urbstats_stats *)tapdata;
+
+	memset(stats->dirs, 0, sizeof stats->dirs);
+	g_array_set_size(stats->intervals, 0);
+}
+
+static gboolean urbstats_packet(void *tapdata, packet_info *pinfo, epan_dissect_t *edt, const void *data)
+{
+	urbstats_stats *stats = (urbstats_stats *)tapdata;
+	const topdog_frame_info *info = (const topdog_frame_info *)data;
+	urbstats_interval *interval;
+	urbstats_dir *dir;
+	guint second;
+	int d, bucket;
+
+	if (info->pdu_type == TOPDOG_PDU_MRXD)
+		d = 0;
+	else if (info->pdu_type == TOPDOG_PDU_MTXD)
+		d = 1;
+	else
+		return FALSE;
+
+	dir = &stats->dirs[d];
+	dir->urbs++;
+	dir->descs += info->chain_count;
+	dir->urb_bytes += info->urb_len;
+	dir->payload_bytes += info->payload_bytes;
+	dir->header_bytes += info->header_bytes;
+	dir->padding += topdog_urb_padding(info);
+	dir->desc_counts[MIN(info->chain_count, URBSTATS_MAX_DESCS)]++;
+	for (bucket = 0; bucket < URBSTATS_SIZE_BUCKETS - 1 && (info->urb_len >> (bucket + 1)) != 0; bucket++)
+		;
+	dir->sizes[bucket]++;
+
+	second = pinfo->rel_ts.secs > 0 ? (guint)pinfo->rel_ts.secs : 0;
+	if (second >= stats->intervals->len)
+		g_array_set_size(stats->intervals, second + 1);
+	interval = &g_array_index(stats->intervals, urbstats_interval, second);
+	interval->urbs[d]++;
+	interval->urb_bytes[d] += info->urb_len;
+	interval->descs[d] += info->chain_count;
+
+	return TRUE;
+}
+
+static void urbstats_draw(void *tapdata)
+{
+	static const char *dir_names[2] = {"RX (MRXD)", "TX (MTXD)"};
+	urbstats_stats *stats = (urbstats_stats *)tapdata;
+	guint i;
+	int d;
+
+	printf("\n===================================================================\n");
+	printf("TopDog URB Efficiency%s%s\n", stats->filter ? " Filter: " : "", stats->filter ? stats->filter : "");
+
+	for (d = 0; d < 2; d++) {
+		const urbstats_dir *dir = &stats->dirs[d];
+
+		if (dir->urbs == 0)
+			continue;
+		printf("\n%s: %" G_GINT64_MODIFIER "u URBs, %.2f descriptors/URB, %.0f bytes/URB\n", dir_names[d],
+			dir->urbs, (double)dir->descs / dir->urbs, (double)dir->urb_bytes / dir->urbs);
+		printf("Bytes: payload %.1f%%  headers %.1f%%  padding %.1f%%\n",
+			percent(dir->payload_bytes, dir->urb_bytes), percent(dir->header_bytes, dir->urb_bytes),
+			percent(dir->padding, dir->urb_bytes));
+
+		printf("Descriptors/URB        URBs\n");
+		for (i = 0; i <= URBSTATS_MAX_DESCS; i++)
+			if (dir->desc_counts[i] != 0)
+				printf("%14u%s %10" G_GINT64_MODIFIER "u  %5.1f%%\n", i, i == URBSTATS_MAX_DESCS ? "+" : " ",
+					dir->desc_counts[i], percent(dir->desc_counts[i], dir->urbs));
+
+		printf("URB bytes              URBs\n");
+		for (i = 0; i < URBSTATS_SIZE_BUCKETS; i++)
+			if (dir->sizes[i] != 0)
+				printf("%6u - %-6u  %10" G_GINT64_MODIFIER "u  %5.1f%%\n", i ? 1u << i : 0,
+					(2u << i) - 1, dir->sizes[i], percent(dir->sizes[i], dir->urbs));
+	}
+
+	printf("\nSecond    RX URBs  bytes/URB  descs/URB    TX URBs  bytes/URB  descs/URB\n");
+	for (i = 0; i < stats->intervals->len; i++) {
+		const urbstats_interval *interval = &g_array_index(stats->intervals, urbstats_interval, i);
+
+		if (interval->urbs[0] == 0 && interval->urbs[1] == 0)
+			continue;
+		printf("%6u", i);
+		for (d = 0; d < 2; d++) {
+			if (interval->urbs[d] == 0)
+				printf(" %10d %10s %10s", 0, "-", "-");
+			else
+				printf(" %10" G_GINT64_MODIFIER "u %10.0f %10.2f", interval->urbs[d],
+					(double)interval->urb_bytes[d] / interval->urbs[d],
+					(double)interval->descs[d] / interval->urbs[d]);
+		}
+		printf("\n");
+	}
+	printf("===================================================================\n");
+}
+
+static void urbstats_init(const char *opt_arg, void *userdata)
+{
+	urbstats_stats *stats = g_new0(urbstats_stats, 1);
+	GString *error_string;
+
+	if (strncmp(opt_arg, "topdog,urbstats,", 16) == 0)
+		stats->filter = g_strdup(opt_arg + 16);
+	stats->intervals = g_array_new(FALSE, TRUE, sizeof(urbstats_interval));
+
+	error_string = register_tap_listener("topdog", stats, stats->filter, 0,
+		urbstats_reset, urbstats_packet, urbstats_draw);
+	if (error_string) {
+		fprintf(stderr, "tshark: Couldn't register topdog,urbstats tap: %s\n", error_string->str);
+		g_string_free(error_string, TRUE);
+		g_array_free(stats->intervals, TRUE);
+		g_free(stats->filter);
+		g_free(stats);
+		exit(1);
+	}
+}
+
+static stat_tap_ui urbstats_ui = {
+	REGISTER_STAT_GROUP_GENERIC,
+	NULL,
+	"topdog,urbstats",
+	urbstats_init,
+	0,
+	NULL
+};
+
+/* -z topdog,txring[,filter]
+** TX ring occupancy per TX priority, from the state tracked on the first
+** pass: mean and peak occupancy, and how often the ring ran full. */
+typedef struct _txring_pri {
+	guint64 wcbs;
+	guint64 occupancy_sum;
+	guint32 high_water;
+	guint32 size;
+	guint64 full;
+	double first_full_ts;
+	double last_full_ts;
+} txring_pri;
+
+typedef struct _txring_stats {
+	char *filter;
+	txring_pri pris[TOPDOG_NUM_TX_PRI];
+} txring_stats;
+
+static void txring_reset(void *tapdata)
+{
+	txring_stats *stats = (txring_stats *)tapdata;
+
+	memset(stats->pris, 0, sizeof stats->pris);
+}
+
+static gboolean txring_packet(void *tapdata, packet_info *pinfo, epan_dissect_t *edt, const void *data)
+{
+	txring_stats *stats = (txring_stats *)tapdata;
+	const topdog_tx_info *tx = (const topdog_tx_info *)data;
+	txring_pri *pri;
+
+	if (!tx->ring_tracked || tx->tx_pri >= TOPDOG_NUM_TX_PRI)
+		return FALSE;
+
+	pri = &stats->pris[tx->tx_pri];
+	pri->wcbs++;
+	pri->occupancy_sum += tx->ring_occupancy;
+	if (tx->ring_occupancy > pri->high_water)
+		pri->high_water = tx->ring_occupancy;
+	pri->size = tx->ring_size;
+	if (tx->ring_full) {
+		pri->last_full_ts = nstime_to_sec(&pinfo->rel_ts);
+		if (pri->full++ == 0)
+			pri->first_full_ts = pri->last_full_ts;
+	}
+
+	return TRUE;
+}
+
+static void txring_draw(void *tapdata)
+{
+	txring_stats *stats = (txring_stats *)tapdata;
+	int i;
+
+	printf("\n===================================================================\n");
+	printf("TopDog TX Ring Occupancy%s%s\n", stats->filter ? " Filter: " : "", stats->filter ? stats->filter : "");
+	printf("Priority       WCBs  Ring  Mean occ.  High-water   Full   First/last full (s)\n");
+	for (i = 0; i < TOPDOG_NUM_TX_PRI; i++) {
+		const txring_pri *pri = &stats->pris[i];
+
+		if (pri->wcbs == 0)
+			continue;
+		printf("%8d %10" G_GINT64_MODIFIER "u %5u %10.1f %11u %6" G_GINT64_MODIFIER "u", i, pri->wcbs,
+			pri->size, (double)pri->occupancy_sum / pri->wcbs, pri->high_water, pri->full);
+		if (pri->full)
+			printf("   %.3f / %.3f", pri->first_full_ts, pri->last_full_ts);
+		printf("\n");
+	}
+	printf("===================================================================\n");
+}
+
+static void txring_init(const char *opt_arg, void *userdata)
+{
+	txring_stats *stats = g_new0(txring_stats, 1);
+	GString *error_string;
+
+	if (strncmp(opt_arg, "topdog,txring,", 14) == 0)
+		stats->filter = g_strdup(opt_arg + 14);
+
+	error_string = register_tap_listener("topdog.tx", stats, stats->filter, 0,
+		txring_reset, txring_packet, txring_draw);
+	if (error_string) {
+		fprintf(stderr, "tshark: Couldn't register topdog,txring tap: %s\n", error_string->str);
+		g_string_free(error_string, TRUE);
+		g_free(stats->filter);
+		g_free(stats);
+		exit(1);
+	}
+}
+
+static stat_tap_ui txring_ui = {
+	REGISTER_STAT_GROUP_GENERIC,
+	NULL,
+	"topdog,txring",
+	txring_init,
+	0,
+	NULL
+};
+
+/* -z topdog,airtime[,filter]
+** Estimated TX airtime per destination MAC and TID, from the WCB rate info
+** and packet length. Shares are of the total estimated airtime. */
+typedef struct _airtime_station {
+	guint64 key;	/* MAC address, first; the hash table key points here */
+	guint8 addr[6];
+	guint64 airtime_us;
+	guint64 frames;
+	guint64 bytes;
+	guint64 tid_airtime_us[16];
+	guint64 tid_frames[16];
+} airtime_station;
+
+typedef struct _airtime_stats {
+	char *filter;
+	GHashTable *stations;
+	guint64 airtime_us;
+	guint64 unknown_rate;
+} airtime_stats;
+
+static void airtime_reset(void *tapdata)
+{
+	airtime_stats *stats = (airtime_stats *)tapdata;
+
+	g_hash_table_remove_all(stats->stations);
+	stats->airtime_us = 0;
+	stats->unknown_rate = 0;
+}
+
+static gboolean airtime_packet(void *tapdata, packet_info *pinfo, epan_dissect_t *edt, const void *data)
+{
+	airtime_stats *stats = (airtime_stats *)tapdata;
+	const topdog_tx_info *tx = (const topdog_tx_info *)data;
+	guint32 airtime = topdog_airtime_us(tx->rate_info, tx->pkt_len);
+	guint tid = tx->qos_ctrl & 0x000f;
+	airtime_station *station;
+	guint64 key = 0;
+	int i;
+
+	if (airtime == 0) {
+		stats->unknown_rate++;
+		return TRUE;
+	}
+
+	for (i = 0; i < 6; i++)
+		key = (key << 8) | tx->dest_mac[i];
+
+	station = (airtime_station *)g_hash_table_lookup(stats->stations, &key);
+	if (station == NULL) {
+		station = g_new0(airtime_station, 1);
+		station->key = key;
+		memcpy(station->addr, tx->dest_mac, 6);
+		g_hash_table_insert(stats->stations, &station->key, station);
+	}
+
+	station->airtime_us += airtime;
+	station->frames++;
+	station->bytes += tx->pkt_len;
+	station->tid_airtime_us[tid] += airtime;
+	station->tid_frames[tid]++;
+	stats->airtime_us += airtime;
+
+	return TRUE;
+}
+
+static gint airtime_compare(gconstpointer a, gconstpointer b)
+{
+	const airtime_station *sa = (const airtime_station *)a;
+	const airtime_station *sb = (const airtime_station *)b;
+
+	if (sa->airtime_us != sb->airtime_us)
+		return sa->airtime_us < sb->airtime_us ? 1 : -1;
+	return sa->key < sb->key ? -1 : sa->key > sb->key;
+}
+
+static void airtime_draw(void *tapdata)
+{
+	airtime_stats *stats = (airtime_stats *)tapdata;
+	GList *stations = g_list_sort(g_hash_table_get_values(stats->stations), airtime_compare);
+	GList *l;
+	int tid;
+
+	printf("\n===================================================================\n");
+	printf("TopDog TX Airtime%s%s\n", stats->filter ? " Filter: " : "", stats->filter ? stats->filter : "");
+	printf("Estimated airtime: %.3f s", stats->airtime_us / 1e6);
+	if (stats->unknown_rate)
+		printf(" (%" G_GINT64_MODIFIER "u frames with unknown rate excluded)", stats->unknown_rate);
+	printf("\n\n");
+
+	printf("Destination         TID     Frames        Bytes   Airtime ms   Share\n");
+	for (l = stations; l != NULL; l = l->next) {
+		const airtime_station *station = (const airtime_station *)l->data;
+
+		printf("%02x:%02x:%02x:%02x:%02x:%02x   all %10" G_GINT64_MODIFIER "u %12" G_GINT64_MODIFIER "u %12.1f  %5.1f%%\n",
+			station->addr[0], station->addr[1], station->addr[2],
+			station->addr[3], station->addr[4], station->addr[5],
+			station->frames, station->bytes, station->airtime_us / 1e3,
+			percent(station->airtime_us, stats->airtime_us));
+		for (tid = 0; tid < 16; tid++)
+			if (station->tid_frames[tid] != 0)
+				printf("                    %3d %10" G_GINT64_MODIFIER "u %12s %12.1f  %5.1f%%\n",
+					tid, station->tid_frames[tid], "",
+					station->tid_airtime_us[tid] / 1e3,
+					percent(station->tid_airtime_us[tid], stats->airtime_us));
+	}
+	printf("===================================================================\n");
+
+	g_list_free(stations);
+}
+
+static void airtime_init(const char *opt_arg, void *userdata)
+{
+	airtime_stats *stats = g_new0(airtime_stats, 1);
+	GString *error_string;
+
+	if (strncmp(opt_arg, "topdog,airtime,", 15) == 0)
+		stats->filter = g_strdup(opt_arg + 15);
+	stats->stations = g_hash_table_new_full(g_int64_hash, g_int64_equal, NULL, g_free);
+
+	error_string = register_tap_listener("topdog.tx", stats, stats->filter, 0,
+		airtime_reset, airtime_packet, airtime_draw);
+	if (error_string) {
+		fprintf(stderr, "tshark: Couldn't register topdog,airtime tap: %s\n", error_string->str);
+		g_string_free(error_string, TRUE);
+		g_hash_table_destroy(stats->stations);
+		g_free(stats->filter);
+		g_free(stats);
+		exit(1);
+	}
+}
+
+static stat_tap_ui airtime_ui = {
+	REGISTER_STAT_GROUP_GENERIC,
+	NULL,
+	"topdog,airtime",
+	airtime_init,
+	0,
+	NULL
+};
+
+/* -z topdog,rateconv[,filter]
+** Rate control behaviour per peer, from three rate_info sources: the WCB the
+** host queues ("host"), the RxPD's TX rate, which is the firmware's current
+** rate towards the sender ("fw"), and the RxPD's RX rate, which is the
+** peer's own choice ("rx"). Each CMD_SET_RATEADAPT_MODE or CMD_USE_FIXED_RATE
+** request, and each (re)association response to or from a peer, starts a
+** convergence window: the rate has converged once it stays unchanged for
+** RATECONV_STABLE_SAMPLES samples, and the time to converge is from the
+** event to the last change before that. A flip is a change back to the
+** previous rate within RATECONV_FLIP_WINDOW; a source oscillates when at least
+** half of its changes, and at least RATECONV_MIN_FLIPS, are flips. */
+#define RATECONV_STABLE_SAMPLES	50
+#define RATECONV_FLIP_WINDOW	1.0	/* seconds */
+#define RATECONV_MIN_FLIPS	3
+
+#define RATECONV_HOST	0
+#define RATECONV_FW	1
+#define RATECONV_RX	2
+#define RATECONV_NUM_SOURCES	3
+
+#define RATECONV_EVENT_RATEADAPT	0
+#define RATECONV_EVENT_FIXED_RATE	1
+#define RATECONV_EVENT_ASSOC	2
+
+typedef struct _rateconv_track {
+	gboolean have_rate;
+	guint16 rate;	/* TOPDOG_RATE_INDEX of the last sample */
+	guint16 prev_rate;	/* the rate before the last change */
+	double last_change;
+	guint32 stable;	/* samples since the last change */
+	gboolean converging;
+	double event_ts;
+	guint64 samples;
+	guint64 changes;
+	guint64 flips;
+	guint32 converged;
+	guint32 unconverged;	/* windows cut short by the next event */
+	double converge_sum;
+	double converge_max;
+} rateconv_track;
+
+typedef struct _rateconv_peer {
+	guint64 key;	/* MAC address, first; the hash table key points here */
+	guint8 addr[6];
+	rateconv_track tracks[RATECONV_NUM_SOURCES];
+} rateconv_peer;
+
+typedef struct _rateconv_stats {
+	char *filter;
+	GHashTable *peers;
+	guint32 events[3];
+} rateconv_stats;
+
+static void rateconv_reset(void *tapdata)
+{
+	rateconv_stats *stats = (rateconv_stats *)tapdata;
+
+	g_hash_table_remove_all(stats->peers);
+	memset(stats->events, 0, sizeof stats->events);
+}
+
+static rateconv_peer *rateconv_get_peer(rateconv_stats *stats, const guint8 *addr)
+{
+	rateconv_peer *peer;
+	guint64 key = 0;
+	int i;
+
+	for (i = 0; i < 6; i++)
+		key = (key << 8) | addr[i];
+
+	peer = (rateconv_peer *)g_hash_table_lookup(stats->peers, &key);
+	if (peer == NULL) {
+		peer = g_new0(rateconv_peer, 1);
+		peer->key = key;
+		memcpy(peer->addr, addr, 6);
+		g_hash_table_insert(stats->peers, &peer->key, peer);
+	}
+
+	return peer;
+}
+
+static void rateconv_start(rateconv_track *track, double ts)
+{
+	if (track->converging)
+		track->unconverged++;
+	track->converging = TRUE;
+	track->event_ts = ts;
+	track->stable = 0;
+}
+
+static void rateconv_start_peer(rateconv_peer *peer, double ts)
+{
+	int i;
+
+	for (i = 0; i < RATECONV_NUM_SOURCES; i++)
+		rateconv_start(&peer->tracks[i], ts);
+}
+
+static void rateconv_start_all(gpointer key, gpointer value, gpointer userdata)
+{
+	rateconv_start_peer((rateconv_peer *)value, *(const double *)userdata);
+}
+
+static void rateconv_sample(rateconv_track *track, guint16 rate_info, double ts)
+{
+	guint16 rate = TOPDOG_RATE_INDEX(rate_info);
+
+	track->samples++;
+	if (!track->have_rate) {
+		track->have_rate = TRUE;
+		track->rate = track->prev_rate = rate;
+		track->last_change = ts;
+	} else if (rate != track->rate) {
+		track->changes++;
+		if (rate == track->prev_rate && ts - track->last_change <= RATECONV_FLIP_WINDOW)
+			track->flips++;
+		track->prev_rate = track->rate;
+		track->rate = rate;
+		track->last_change = ts;
+		track->stable = 0;
+		return;
+	}
+
+	if (track->converging && ++track->stable >= RATECONV_STABLE_SAMPLES) {
+		double t = track->last_change > track->event_ts ? track->last_change - track->event_ts : 0;
+
+		track->converging = FALSE;
+		track->converged++;
+		track->converge_sum += t;
+		if (t > track->converge_max)
+			track->converge_max = t;
+	}
+}
+
+/* Returns TRUE if the 802.11 frame is a (re)association response. */
+static gboolean rateconv_is_assoc_resp(tvbuff_t *tvb, guint32 wlan_offset, gint wlan_len)
+{
+	guint8 fc;
+
+	if (wlan_len < 1 || !tvb_bytes_exist(tvb, wlan_offset, 1))
+		return FALSE;
+	fc = tvb_get_guint8(tvb, wlan_offset);
+	return (fc & 0x0c) == 0 && ((fc >> 4) == 1 || (fc >> 4) == 3);
+}
+
+static gboolean rateconv_cmd_packet(void *tapdata, packet_info *pinfo, epan_dissect_t *edt, const void *data)
+{
+	rateconv_stats *stats = (rateconv_stats *)tapdata;
+	const topdog_frame_info *info = (const topdog_frame_info *)data;
+	double ts = nstime_to_sec(&pinfo->rel_ts);
+
+	if (info->pdu_type != TOPDOG_PDU_MCBW)
+		return FALSE;
+	if (info->cmd == 0x0203)
+		stats->events[RATECONV_EVENT_RATEADAPT]++;
+	else if (info->cmd == 0x0126)
+		stats->events[RATECONV_EVENT_FIXED_RATE]++;
+	else
+		return FALSE;
+
+	g_hash_table_foreach(stats->peers, rateconv_start_all, &ts);
+	return TRUE;
+}
+
+static gboolean rateconv_tx_packet(void *tapdata, packet_info *pinfo, epan_dissect_t *edt, const void *data)
+{
+	rateconv_stats *stats = (rateconv_stats *)tapdata;
+	const topdog_tx_info *tx = (const topdog_tx_info *)data;
+	rateconv_peer *peer = rateconv_get_peer(stats, tx->dest_mac);
+	double ts = nstime_to_sec(&pinfo->rel_ts);
+
+	if (rateconv_is_assoc_resp(tx->tvb, tx->wlan_offset, tx->wlan_len)) {
+		stats->events[RATECONV_EVENT_ASSOC]++;
+		rateconv_start_peer(peer, ts);
+	}
+	/* 0 leaves the choice to the firmware. */
+	if (tx->rate_info != 0)
+		rateconv_sample(&peer->tracks[RATECONV_HOST], tx->rate_info, ts);
+
+	return TRUE;
+}
+
+static gboolean rateconv_rx_packet(void *tapdata, packet_info *pinfo, epan_dissect_t *edt, const void *data)
+{
+	rateconv_stats *stats = (rateconv_stats *)tapdata;
+	const topdog_rx_info *rx = (const topdog_rx_info *)data;
+	double ts = nstime_to_sec(&pinfo->rel_ts);
+	guint8 addr[6];
+	rateconv_peer *peer;
+
+	/* The sender is the frame's second address. */
+	if (rx->wlan_len < 16 || !tvb_bytes_exist(rx->tvb, rx->wlan_offset+10, 6))
+		return FALSE;
+	tvb_memcpy(rx->tvb, addr, rx->wlan_offset+10, 6);
+	peer = rateconv_get_peer(stats, addr);
+
+	if (rateconv_is_assoc_resp(rx->tvb, rx->wlan_offset, rx->wlan_len)) {
+		stats->events[RATECONV_EVENT_ASSOC]++;
+		rateconv_start_peer(peer, ts);
+	}
+	rateconv_sample(&peer->tracks[RATECONV_FW], rx->tx_rate_info, ts);
+	rateconv_sample(&peer->tracks[RATECONV_RX], rx->rx_rate_info, ts);
+
+	return TRUE;
+}
+
+static void rateconv_rate_str(gchar *buf, gsize size, guint16 rate)
+{
+	if (TOPDOG_RATE_HT(rate))
+		g_snprintf(buf, size, "MCS %u%s%s", TOPDOG_RATE_MCS(rate),
+			TOPDOG_RATE_BW40(rate) ? " 40MHz" : "", TOPDOG_RATE_SHORT_GI(rate) ? " SGI" : "");
+	else
+		g_snprintf(buf, size, "%g Mbps", phy_rates[rate].kbps / 1000.0);
+}
+
+static gint rateconv_compare(gconstpointer a, gconstpointer b)
+{
+	const rateconv_peer *pa = (const rateconv_peer *)a;
+	const rateconv_peer *pb = (const rateconv_peer *)b;
+
+	return pa->key < pb->key ? -1 : pa->key > pb->key;
+}
+
+static void rateconv_draw(void *tapdata)
+{
+	static const char *source_names[RATECONV_NUM_SOURCES] = {"host", "fw", "rx"};
+	rateconv_stats *stats = (rateconv_stats *)tapdata;
+	GList *peers = g_list_sort(g_hash_table_get_values(stats->peers), rateconv_compare);
+	GList *l;
+	int i;
+
+	printf("\n===================================================================\n");
+	printf("TopDog Rate Convergence%s%s\n", stats->filter ? " Filter: " : "", stats->filter ? stats->filter : "");
+	printf("Events: SET_RATEADAPT_MODE %u  USE_FIXED_RATE %u  (re)association %u\n\n",
+		stats->events[RATECONV_EVENT_RATEADAPT], stats->events[RATECONV_EVENT_FIXED_RATE],
+		stats->events[RATECONV_EVENT_ASSOC]);
+
+	printf("Peer               Source   Samples  Changes   Flips  Settled  Unsettled  Avg ms  Max ms  Last rate\n");
+	for (l = peers; l != NULL; l = l->next) {
+		const rateconv_peer *peer = (const rateconv_peer *)l->data;
+
+		for (i = 0; i < RATECONV_NUM_SOURCES; i++) {
+			const rateconv_track *track = &peer->tracks[i];
+			gchar rate[32];
+
+			if (track->samples == 0)
+				continue;
+			rateconv_rate_str(rate, sizeof rate, track->rate);
+			printf("%02x:%02x:%02x:%02x:%02x:%02x  %-6s %9" G_GINT64_MODIFIER "u %8" G_GINT64_MODIFIER "u %7"
+				G_GINT64_MODIFIER "u %8u %10u",
+				peer->addr[0], peer->addr[1], peer->addr[2], peer->addr[3], peer->addr[4], peer->addr[5],
+				source_names[i], track->samples, track->changes, track->flips,
+				track->converged, track->unconverged + (track->converging ? 1 : 0));
+			if (track->converged != 0)
+				printf(" %7.1f %7.1f", track->converge_sum / track->converged * 1e3, track->converge_max * 1e3);
+			else
+				printf(" %7s %7s", "-", "-");
+			printf("  %s%s\n", rate,
+				track->flips >= RATECONV_MIN_FLIPS && track->flips * 2 >= track->changes ? "  OSCILLATING" : "");
+		}
+	}
+	printf("===================================================================\n");
+
+	g_list_free(peers);
+}
+
+static void rateconv_init(const char *opt_arg, void *userdata)
+{
+	rateconv_stats *stats = g_new0(rateconv_stats, 1);
+	GString *error_string;
+
+	if (strncmp(opt_arg, "topdog,rateconv,", 16) == 0)
+		stats->filter = g_strdup(opt_arg + 16);
+	stats->peers = g_hash_table_new_full(g_int64_hash, g_int64_equal, NULL, g_free);
+
+	error_string = register_tap_listener("topdog", stats, stats->filter, 0,
+		rateconv_reset, rateconv_cmd_packet, rateconv_draw);
+	if (error_string == NULL)
+		error_string = register_tap_listener("topdog.tx", stats, stats->filter, 0,
+			NULL, rateconv_tx_packet, NULL);
+	if (error_string == NULL)
+		error_string = register_tap_listener("topdog.rx", stats, stats->filter, 0,
+			NULL, rateconv_rx_packet, NULL);
+	if (error_string) {
+		fprintf(stderr, "tshark: Couldn't register topdog,rateconv tap: %s\n", error_string->str);
+		g_string_free(error_string, TRUE);
+		exit(1);
+	}
+}
+
+static stat_tap_ui rateconv_ui = {
+	REGISTER_STAT_GROUP_GENERIC,
+	NULL,
+	"topdog,rateconv",
+	rateconv_init,
+	0,
+	NULL
+};
+
+/* -z topdog,scan[,filter]
+** Scan timeline. A scan runs from a CMD_SET_PRE_SCAN request to the next
+** CMD_SET_POST_SCAN request, and dwells on each channel from the response to
+** its RF_CHANNEL request (or the request itself, if unanswered) until the
+** next switch or the end of the scan. RxPDs received during a dwell are
+** counted against it, separately when they report another channel. */
+typedef struct _scan_dwell {
+	guint8 channel;
+	guint32 frame;	/* of the RF_CHANNEL request */
+	double switch_ms;	/* request to response; < 0 if unanswered */
+	double start;
+	double end;
+	guint64 frames;
+	guint64 other_frames;	/* RxPDs for a different channel */
+} scan_dwell;
+
+typedef struct _scan_run {
+	guint32 frame;	/* of the PRE_SCAN request */
+	double start;
+	double end;
+	gboolean complete;	/* ended by POST_SCAN, not by another PRE_SCAN or the capture */
+	GArray *dwells;
+} scan_run;
+
+typedef struct _scan_channel {
+	guint32 dwells;
+	guint32 acked;
+	double switch_ms;
+	double dwell_ms;
+	guint64 frames;
+} scan_channel;
+
+typedef struct _scan_stats {
+	char *filter;
+	GPtrArray *scans;
+	scan_run *current;
+	double last_ts;
+} scan_stats;
+
+static void scan_end(scan_stats *stats, double ts, gboolean complete)
+{
+	scan_run *scan = stats->current;
+
+	if (scan == NULL)
+		return;
+	if (scan->dwells->len != 0)
+		g_array_index(scan->dwells, scan_dwell, scan->dwells->len - 1).end = ts;
+	scan->end = ts;
+	scan->complete = complete;
+	stats->current = NULL;
+}
+
+static void scan_free(gpointer data)
+{
+	scan_run *scan = (scan_run *)data;
+
+	g_array_free(scan->dwells, TRUE);
+	g_free(scan);
+}
+
+static void scan_reset(void *tapdata)
+{
+	scan_stats *stats = (scan_stats *)tapdata;
+
+	g_ptr_array_free(stats->scans, TRUE);
+	stats->scans = g_ptr_array_new_with_free_func(scan_free);
+	stats->current = NULL;
+	stats->last_ts = 0;
+}
+
+static gboolean scan_cmd_packet(void *tapdata, packet_info *pinfo, epan_dissect_t *edt, const void *data)
+{
+	scan_stats *stats = (scan_stats *)tapdata;
+	const topdog_frame_info *info = (const topdog_frame_info *)data;
+	double ts = nstime_to_sec(&pinfo->rel_ts);
+	scan_run *scan = stats->current;
+	scan_dwell dwell, *last;
+
+	stats->last_ts = ts;
+	if (info->pdu_type != TOPDOG_PDU_MCBW && info->pdu_type != TOPDOG_PDU_MCSW)
+		return FALSE;
+
+	switch (info->cmd) {
+	case 0x0107:
+		scan_end(stats, ts, FALSE);
+		scan = g_new0(scan_run, 1);
+		scan->frame = pinfo->num;
+		scan->start = ts;
+		scan->dwells = g_array_new(FALSE, TRUE, sizeof(scan_dwell));
+		g_ptr_array_add(stats->scans, scan);
+		stats->current = scan;
+		return TRUE;
+	case 0x0108:
+		scan_end(stats, ts, TRUE);
+		return TRUE;
+	case 0x001d: case 0x010a:
+		if (scan == NULL || info->rf_channel == 0)
+			return FALSE;
+		if (scan->dwells->len != 0)
+			g_array_index(scan->dwells, scan_dwell, scan->dwells->len - 1).end = ts;
+		memset(&dwell, 0, sizeof dwell);
+		dwell.channel = info->rf_channel;
+		dwell.frame = pinfo->num;
+		dwell.switch_ms = -1;
+		dwell.start = ts;
+		g_array_append_val(scan->dwells, dwell);
+		return TRUE;
+	case 0x801d: case 0x810a:
+		if (scan == NULL || scan->dwells->len == 0)
+			return FALSE;
+		last = &g_array_index(scan->dwells, scan_dwell, scan->dwells->len - 1);
+		if (info->peer_frame == 0 || last->frame != info->peer_frame)
+			return FALSE;
+		last->switch_ms = nstime_to_msec(&info->rtt);
+		last->start = ts;
+		return TRUE;
+	}
+
+	return FALSE;
+}
 
-static const int *rxpd_ctrl_flags[] = {
-	&hf_rxpd_ctrl_is_ampdu,
-	&hf_rxpd_ctrl_owner,
-	&hf_rxpd_ctrl_decrypt_error,
-	&hf_rxpd_ctrl_error_type,
-	&hf_rxpd_ctrl_key_index,
-	&hf_rxpd_ctrl_reserved,
+static gboolean scan_rx_packet(void *tapdata, packet_info *pinfo, epan_dissect_t *edt, const void *data)
+{
+	scan_stats *stats = (scan_stats *)tapdata;
+	const topdog_rx_info *rx = (const topdog_rx_info *)data;
+	scan_dwell *dwell;
+
+	stats->last_ts = nstime_to_sec(&pinfo->rel_ts);
+	if (stats->current == NULL || stats->current->dwells->len == 0)
+		return FALSE;
+
+	dwell = &g_array_index(stats->current->dwells, scan_dwell, stats->current->dwells->len - 1);
+	if (rx->channel == dwell->channel)
+		dwell->frames++;
+	else
+		dwell->other_frames++;
+
+	return TRUE;
+}
+
+static void scan_draw(void *tapdata)
+{
+	scan_stats *stats = (scan_stats *)tapdata;
+	scan_channel channels[256];
+	double total_ms = 0;
+	guint i, j;
+
+	/* A scan still open runs to the last frame seen so far; it stays open
+	** in case more frames follow a redraw. */
+	if (stats->current != NULL) {
+		scan_run *scan = stats->current;
+
+		scan_end(stats, stats->last_ts, FALSE);
+		stats->current = scan;
+	}
+
+	memset(channels, 0, sizeof channels);
+	printf("\n===================================================================\n");
+	printf("TopDog Channel Scans%s%s\n", stats->filter ? " Filter: " : "", stats->filter ? stats->filter : "");
+
+	for (i = 0; i < stats->scans->len; i++) {
+		const scan_run *scan = (const scan_run *)g_ptr_array_index(stats->scans, i);
+
+		total_ms += (scan->end - scan->start) * 1e3;
+		printf("\nScan %u: frame %u, %.6f s, %.1f ms, %u channel switches%s\n", i + 1, scan->frame,
+			scan->start, (scan->end - scan->start) * 1e3, scan->dwells->len,
+			scan->complete ? "" : " (no POST_SCAN)");
+		printf("Channel    Frame   Switch ms   Dwell ms     RxPDs   Other\n");
+		for (j = 0; j < scan->dwells->len; j++) {
+			const scan_dwell *dwell = &g_array_index(scan->dwells, scan_dwell, j);
+			scan_channel *channel = &channels[dwell->channel];
+			double dwell_ms = (dwell->end - dwell->start) * 1e3;
+
+			printf("%7u %8u ", dwell->channel, dwell->frame);
+			if (dwell->switch_ms >= 0)
+				printf("%11.3f", dwell->switch_ms);
+			else
+				printf("%11s", "-");
+			printf(" %10.3f %9" G_GINT64_MODIFIER "u %7" G_GINT64_MODIFIER "u\n", dwell_ms,
+				dwell->frames, dwell->other_frames);
+
+			channel->dwells++;
+			channel->dwell_ms += dwell_ms;
+			channel->frames += dwell->frames;
+			if (dwell->switch_ms >= 0) {
+				channel->acked++;
+				channel->switch_ms += dwell->switch_ms;
+			}
+		}
+	}
+
+	printf("\nScans: %u, total %.1f ms, mean %.1f ms\n", stats->scans->len, total_ms,
+		stats->scans->len ? total_ms / stats->scans->len : 0);
+	printf("Channel   Dwells   Avg switch ms   Avg dwell ms     RxPDs\n");
+	for (i = 0; i < 256; i++) {
+		const scan_channel *channel = &channels[i];
+
+		if (channel->dwells == 0)
+			continue;
+		printf("%7u %8u ", i, channel->dwells);
+		if (channel->acked != 0)
+			printf("%15.3f", channel->switch_ms / channel->acked);
+		else
+			printf("%15s", "-");
+		printf(" %14.3f %9" G_GINT64_MODIFIER "u\n", channel->dwell_ms / channel->dwells, channel->frames);
+	}
+	printf("===================================================================\n");
+}
+
+static void scan_init(const char *opt_arg, void *userdata)
+{
+	scan_stats *stats = g_new0(scan_stats, 1);
+	GString *error_string;
+
+	if (strncmp(opt_arg, "topdog,scan,", 12) == 0)
+		stats->filter = g_strdup(opt_arg + 12);
+	stats->scans = g_ptr_array_new_with_free_func(scan_free);
+
+	error_string = register_tap_listener("topdog", stats, stats->filter, 0,
+		scan_reset, scan_cmd_packet, scan_draw);
+	if (error_string == NULL)
+		error_string = register_tap_listener("topdog.rx", stats, stats->filter, 0,
+			NULL, scan_rx_packet, NULL);
+	if (error_string) {
+		fprintf(stderr, "tshark: Couldn't register topdog,scan tap: %s\n", error_string->str);
+		g_string_free(error_string, TRUE);
+		exit(1);
+	}
+}
+
+static stat_tap_ui scan_ui = {
+	REGISTER_STAT_GROUP_GENERIC,
+	NULL,
+	"topdog,scan",
+	scan_init,
+	0,
 	NULL
 };
 
-static gint *ett_list[] = {
-	&ett_topdog,
-	&ett_qos_ctrl,
-	&ett_rate_info,
-	&ett_rxpd_ctrl
-};
+/* -z topdog,loopback[,frames][,filter]
+** Host-to-device-to-host latency in loopback mode (CMD_SET_LOOPBACK_MODE).
+** Every WCB frame is keyed by the CRC-32 and length of its body, after the
+** 30-byte header, and waits in a hash table until an RxPD frame with the same
+** key comes back; identical bodies match first in, first out. Frames not
+** back within LOOPBACK_TIMEOUT are counted as lost and dropped, so the table
+** only ever holds the frames in flight. "frames" also lists every match. */
+#define LOOPBACK_TIMEOUT	1.0	/* seconds */
+#define LOOPBACK_HEADER_LEN	30
+#define LOOPBACK_BUCKETS	24	/* log2 microseconds; well past the timeout */
 
-static void dissect_pdu(proto_tree *tree, tvbuff_t *tvb, guint32 offset, packet_info *pinfo);
+typedef struct _loopback_tx {
+	guint64 key;
+	nstime_t ts;
+	guint32 frame;
+	gboolean matched;
+	struct _loopback_tx *next_same;	/* next pending frame with this key */
+} loopback_tx;
 
-static void dissect_fw_type_0(proto_tree *tree, tvbuff_t *tvb, guint32 offset, packet_info *pinfo)
+/* Pending frames with one key, oldest first; the hash table key points here. */
+typedef struct _loopback_key {
+	guint64 key;
+	loopback_tx *head, *tail;
+} loopback_key;
+
+typedef struct _loopback_match {
+	guint32 tx_frame;
+	guint32 rx_frame;
+	guint64 latency_ns;
+} loopback_match;
+
+typedef struct _loopback_stats {
+	char *filter;
+	gboolean list_frames;
+	GHashTable *keys;
+	GQueue pending;	/* loopback_tx, in TX order */
+	GArray *matches;	/* list_frames only */
+	guint32 mode_cmds;
+	guint64 tx;
+	guint64 rx;
+	guint64 matched;
+	guint64 lost;
+	guint64 min_ns, max_ns, sum_ns;
+	guint64 buckets[LOOPBACK_BUCKETS];
+} loopback_stats;
+
+static guint64 loopback_key_of(tvbuff_t *tvb, guint32 wlan_offset, gint wlan_len, gboolean *ok)
 {
-	proto_tree_add_item(tree, hf_pdu_type, tvb, offset+0, 4, ENC_LITTLE_ENDIAN);
-	proto_tree_add_item(tree, hf_fw_seq_num, tvb, offset+4, 4, ENC_LITTLE_ENDIAN);
+	guint32 offset = wlan_offset, len;
+
+	*ok = FALSE;
+	if (wlan_len <= 0 || !tvb_bytes_exist(tvb, wlan_offset, wlan_len))
+		return 0;
+	/* A frame with no body is keyed whole. */
+	if (wlan_len > LOOPBACK_HEADER_LEN)
+		offset += LOOPBACK_HEADER_LEN;
+	len = wlan_len - (offset - wlan_offset);
+
+	*ok = TRUE;
+	return ((guint64)len << 32) | crc32_slice8(tvb_get_ptr(tvb, offset, len), len);
 }
 
-static void dissect_fw_type_1_4(proto_tree *tree, tvbuff_t *tvb, guint32 offset, packet_info *pinfo)
+/* Drops matched frames from the head of the TX queue, and counts unmatched
+** ones older than LOOPBACK_TIMEOUT as lost. */
+static void loopback_expire(loopback_stats *stats, const nstime_t *now)
 {
-	/* TODO: Verify checksums using crc32_ccitt_tvb_offset_seed. */
-	guint32 data_size = tvb_get_letohl(tvb, offset+8);
+	loopback_tx *tx;
 
-	proto_tree_add_item(tree, hf_pdu_type, tvb, offset+0, 4, ENC_LITTLE_ENDIAN);
-	proto_tree_add_item(tree, hf_fw_dest_addr, tvb, offset+4, 4, ENC_LITTLE_ENDIAN);
-	proto_tree_add_item(tree, hf_fw_data_size, tvb, offset+8, 4, ENC_LITTLE_ENDIAN);
-	proto_tree_add_item(tree, hf_fw_header_checksum, tvb, offset+12, 4, ENC_BIG_ENDIAN);
-	proto_tree_add_item(tree, hf_fw_data, tvb, offset+16, data_size, ENC_LITTLE_ENDIAN);
-	proto_tree_add_item(tree, hf_fw_data_checksum, tvb, offset+16+data_size, 4, ENC_BIG_ENDIAN);
+	while ((tx = (loopback_tx *)g_queue_peek_head(&stats->pending)) != NULL) {
+		if (!tx->matched) {
+			nstime_t age;
+			loopback_key *k;
+
+			nstime_delta(&age, now, &tx->ts);
+			if (nstime_to_sec(&age) < LOOPBACK_TIMEOUT)
+				break;
+
+			/* FIFO per key, so the oldest frame is its key's head. */
+			k = (loopback_key *)g_hash_table_lookup(stats->keys, &tx->key);
+			k->head = tx->next_same;
+			if (k->head == NULL)
+				g_hash_table_remove(stats->keys, &tx->key);
+			stats->lost++;
+		}
+		g_queue_pop_head(&stats->pending);
+		g_free(tx);
+	}
 }
 
-static void dissect_topdog_mcbw(proto_tree *tree, tvbuff_t *tvb, guint32 offset, packet_info *pinfo)
+static void loopback_clear(loopback_stats *stats)
 {
-	guint16 cmd_len = tvb_get_letohs(tvb, offset+14);
+	loopback_tx *tx;
 
-	proto_tree_add_item(tree, hf_pdu_type, tvb, offset+0, 4, ENC_LITTLE_ENDIAN);
-	proto_tree_add_item(tree, hf_tag, tvb, offset+4, 2, ENC_LITTLE_ENDIAN);
-	proto_tree_add_item(tree, hf_transfer_len, tvb, offset+6, 2, ENC_LITTLE_ENDIAN);
-	proto_tree_add_item(tree, hf_fun_flag, tvb, offset+8, 2, ENC_LITTLE_ENDIAN);
-	proto_tree_add_item(tree, hf_cmd_wrapper_len, tvb, offset+10, 2, ENC_LITTLE_ENDIAN);
-	proto_tree_add_item(tree, hf_cmd, tvb, offset+12, 2, ENC_LITTLE_ENDIAN);
-	proto_tree_add_item(tree, hf_cmd_len, tvb, offset+14, 2, ENC_LITTLE_ENDIAN);
-	proto_tree_add_item(tree, hf_cmd_seq_num, tvb, offset+16, 2, ENC_LITTLE_ENDIAN);
-	proto_tree_add_item(tree, hf_cmd_result, tvb, offset+18, 2, ENC_LITTLE_ENDIAN);
-	proto_tree_add_item(tree, hf_cmd_body, tvb, offset+20, cmd_len-8, ENC_LITTLE_ENDIAN);
+	while ((tx = (loopback_tx *)g_queue_pop_head(&stats->pending)) != NULL)
+		g_free(tx);
+	g_hash_table_remove_all(stats->keys);
 }
 
-static void dissect_topdog_mcsw(proto_tree *tree, tvbuff_t *tvb, guint32 offset, packet_info *pinfo)
+static void loopback_reset(void *tapdata)
 {
-	guint16 cmd_len = tvb_get_letohs(tvb, offset+14);
+	loopback_stats *stats = (loopback_stats *)tapdata;
 
-	proto_tree_add_item(tree, hf_pdu_type, tvb, offset+0, 4, ENC_LITTLE_ENDIAN);
-	proto_tree_add_item(tree, hf_tag, tvb, offset+4, 2, ENC_LITTLE_ENDIAN);
-	proto_tree_add_item(tree, hf_data_residue, tvb, offset+6, 2, ENC_LITTLE_ENDIAN);
-	proto_tree_add_item(tree, hf_status, tvb, offset+8, 2, ENC_LITTLE_ENDIAN);
-	proto_tree_add_item(tree, hf_cmd_wrapper_len, tvb, offset+10, 2, ENC_LITTLE_ENDIAN);
-	proto_tree_add_item(tree, hf_cmd, tvb, offset+12, 2, ENC_LITTLE_ENDIAN);
-	proto_tree_add_item(tree, hf_cmd_len, tvb, offset+14, 2, ENC_LITTLE_ENDIAN);
-	proto_tree_add_item(tree, hf_cmd_seq_num, tvb, offset+16, 2, ENC_LITTLE_ENDIAN);
-	proto_tree_add_item(tree, hf_cmd_result, tvb, offset+18, 2, ENC_LITTLE_ENDIAN);
-	proto_tree_add_item(tree, hf_cmd_body, tvb, offset+20, cmd_len-8, ENC_LITTLE_ENDIAN);
+	loopback_clear(stats);
+	if (stats->matches != NULL)
+		g_array_set_size(stats->matches, 0);
+	stats->mode_cmds = 0;
+	stats->tx = stats->rx = stats->matched = stats->lost = 0;
+	stats->min_ns = stats->max_ns = stats->sum_ns = 0;
+	memset(stats->buckets, 0, sizeof stats->buckets);
 }
 
-static void dissect_topdog_mtxd(proto_tree *tree, tvbuff_t *tvb, guint32 offset, packet_info *pinfo)
+static gboolean loopback_cmd_packet(void *tapdata, packet_info *pinfo, epan_dissect_t *edt, const void *data)
 {
-	guint16 pkt_len = tvb_get_letohs(tvb, offset+14);
-	guint32 wcb_next_ptr = tvb_get_letohl(tvb, offset+22);
-	guint16 payload_len;
+	const topdog_frame_info *info = (const topdog_frame_info *)data;
 
-	proto_tree_add_item(tree, hf_pdu_type, tvb, offset+0, 4, ENC_LITTLE_ENDIAN);
-	proto_tree_add_item(tree, hf_wcb_ctrl_stat, tvb, offset+4, 2, ENC_LITTLE_ENDIAN);
-	proto_tree_add_item(tree, hf_wcb_tx_pri, tvb, offset+6, 1, ENC_LITTLE_ENDIAN);
-	proto_tree_add_item(tree, hf_wcb_tx_frag_count, tvb, offset+7, 1, ENC_LITTLE_ENDIAN);
-	proto_tree_add_bitmask(tree, tvb, offset+8, hf_wcb_qos_ctrl, ett_qos_ctrl, qos_ctrl_flags, ENC_LITTLE_ENDIAN);
-	proto_tree_add_item(tree, hf_wcb_pkt_ptr, tvb, offset+10, 4, ENC_LITTLE_ENDIAN);
-	proto_tree_add_item(tree, hf_wcb_pkt_len, tvb, offset+14, 2, ENC_LITTLE_ENDIAN);
-	proto_tree_add_item(tree, hf_wcb_dest_mac, tvb, offset+16, 6, ENC_LITTLE_ENDIAN);
-	proto_tree_add_item(tree, hf_wcb_next_ptr, tvb, offset+22, 4, ENC_LITTLE_ENDIAN);
-	proto_tree_add_bitmask(tree, tvb, offset+26, hf_wcb_rate_info, ett_rate_info, rate_info_flags, ENC_LITTLE_ENDIAN);
-	proto_tree_add_item(tree, hf_wcb_reserved, tvb, offset+28, 4, ENC_LITTLE_ENDIAN);
-	proto_tree_add_item(tree, hf_wlan_pkt, tvb, offset+32, pkt_len, ENC_LITTLE_ENDIAN);
+	if (info->pdu_type != TOPDOG_PDU_MCBW || info->cmd != 0x1124)
+		return FALSE;
+	((loopback_stats *)tapdata)->mode_cmds++;
+	return TRUE;
+}
+
+static gboolean loopback_tx_packet(void *tapdata, packet_info *pinfo, epan_dissect_t *edt, const void *data)
+{
+	loopback_stats *stats = (loopback_stats *)tapdata;
+	const topdog_tx_info *info = (const topdog_tx_info *)data;
+	loopback_tx *tx;
+	loopback_key *k;
+	gboolean ok;
+	guint64 key = loopback_key_of(info->tvb, info->wlan_offset, info->wlan_len, &ok);
+
+	loopback_expire(stats, &pinfo->abs_ts);
+	if (!ok)
+		return FALSE;
+
+	tx = g_new0(loopback_tx, 1);
+	tx->key = key;
+	tx->ts = pinfo->abs_ts;
+	tx->frame = pinfo->num;
+	g_queue_push_tail(&stats->pending, tx);
 
-	payload_len = tvb_get_letohs(tvb, offset+32);
-	call_dissector(wlan_handle, tvb_new_subset_length(tvb, offset+34, payload_len+30), pinfo, proto_tree_get_parent_tree(tree));
+	k = (loopback_key *)g_hash_table_lookup(stats->keys, &key);
+	if (k == NULL) {
+		k = g_new0(loopback_key, 1);
+		k->key = key;
+		g_hash_table_insert(stats->keys, &k->key, k);
+	}
+	if (k->head != NULL)
+		k->tail->next_same = tx;
+	else
+		k->head = tx;
+	k->tail = tx;
+	stats->tx++;
 
-	if (wcb_next_ptr != 0)
-		return dissect_pdu(tree, tvb, offset + wcb_next_ptr, pinfo);
+	return TRUE;
 }
 
-static void dissect_topdog_mrxd(proto_tree *tree, tvbuff_t *tvb, guint32 offset, packet_info *pinfo)
+static gboolean loopback_rx_packet(void *tapdata, packet_info *pinfo, epan_dissect_t *edt, const void *data)
 {
-	guint16 pkt_len = tvb_get_letohs(tvb, offset+8);
-	guint16 rxpd_next_ptr = tvb_get_letohs(tvb, offset+10);
+	loopback_stats *stats = (loopback_stats *)tapdata;
+	const topdog_rx_info *rx = (const topdog_rx_info *)data;
+	loopback_tx *tx;
+	loopback_key *k;
+	nstime_t delta;
+	guint64 latency_ns, us;
+	gboolean ok;
+	guint64 key = loopback_key_of(rx->tvb, rx->wlan_offset, rx->wlan_len, &ok);
+	int bucket = 0;
 
-	proto_tree_add_item(tree, hf_pdu_type, tvb, offset+0, 4, ENC_LITTLE_ENDIAN);
-	proto_tree_add_item(tree, hf_rxpd_rx_ctrl, tvb, offset+4, 1, ENC_LITTLE_ENDIAN);
-	proto_tree_add_item(tree, hf_rxpd_rssi, tvb, offset+5, 1, ENC_LITTLE_ENDIAN);
-	proto_tree_add_item(tree, hf_rxpd_channel, tvb, offset+6, 1, ENC_LITTLE_ENDIAN);
-	proto_tree_add_item(tree, hf_rxpd_noise_lvl, tvb, offset+7, 1, ENC_LITTLE_ENDIAN);
-	proto_tree_add_item(tree, hf_rxpd_pkt_len, tvb, offset+8, 2, ENC_LITTLE_ENDIAN);
-	proto_tree_add_item(tree, hf_rxpd_next_ptr, tvb, offset+10, 2, ENC_LITTLE_ENDIAN);
-	proto_tree_add_bitmask(tree, tvb, offset+12, hf_rxpd_qos_ctrl, ett_qos_ctrl, qos_ctrl_flags, ENC_LITTLE_ENDIAN);
-	proto_tree_add_bitmask(tree, tvb, offset+14, hf_rxpd_rxpd_ctrl, ett_rxpd_ctrl, rxpd_ctrl_flags, ENC_LITTLE_ENDIAN);
-	proto_tree_add_bitmask(tree, tvb, offset+16, hf_rxpd_rx_rate_info, ett_rate_info, rate_info_flags, ENC_LITTLE_ENDIAN);
-	proto_tree_add_bitmask(tree, tvb, offset+18, hf_rxpd_tx_rate_info, ett_rate_info, rate_info_flags, ENC_LITTLE_ENDIAN);
-	proto_tree_add_item(tree, hf_wlan_pkt, tvb, offset+20, pkt_len, ENC_LITTLE_ENDIAN);
+	loopback_expire(stats, &pinfo->abs_ts);
+	if (!ok)
+		return FALSE;
+	stats->rx++;
+
+	k = (loopback_key *)g_hash_table_lookup(stats->keys, &key);
+	if (k == NULL)
+		return TRUE;
+	tx = k->head;
+	tx->matched = TRUE;
+	k->head = tx->next_same;
+	if (k->head == NULL)
+		g_hash_table_remove(stats->keys, &key);
 
-	pkt_len = tvb_get_letohs(tvb, offset+20);
-	call_dissector(wlan_handle, tvb_new_subset_length(tvb, offset+22, pkt_len-2), pinfo, proto_tree_get_parent_tree(tree));
+	nstime_delta(&delta, &pinfo->abs_ts, &tx->ts);
+	latency_ns = delta.secs > 0 || (delta.secs == 0 && delta.nsecs > 0)
+		? (guint64)delta.secs * 1000000000 + delta.nsecs : 0;
+	for (us = latency_ns / 1000; us > 1 && bucket < LOOPBACK_BUCKETS - 1; us >>= 1)
+		bucket++;
 
-	if (rxpd_next_ptr != 0)
-		return dissect_pdu(tree, tvb, offset + rxpd_next_ptr, pinfo);
+	if (stats->matched == 0 || latency_ns < stats->min_ns)
+		stats->min_ns = latency_ns;
+	if (latency_ns > stats->max_ns)
+		stats->max_ns = latency_ns;
+	stats->sum_ns += latency_ns;
+	stats->buckets[bucket]++;
+	stats->matched++;
+
+	if (stats->list_frames) {
+		loopback_match match;
+
+		match.tx_frame = tx->frame;
+		match.rx_frame = pinfo->num;
+		match.latency_ns = latency_ns;
+		g_array_append_val(stats->matches, match);
+	}
+
+	return TRUE;
 }
 
-static void dissect_pdu(proto_tree *tree, tvbuff_t *tvb, guint32 offset, packet_info *pinfo)
+static void loopback_draw(void *tapdata)
 {
-	guint32 pdu_type;
+	loopback_stats *stats = (loopback_stats *)tapdata;
+	guint64 sum = 0;
+	guint i;
 
-	if (offset > 0xffff)
-		return;
+	printf("\n===================================================================\n");
+	printf("TopDog Loopback Latency%s%s\n", stats->filter ? " Filter: " : "", stats->filter ? stats->filter : "");
+	printf("SET_LOOPBACK_MODE requests: %u\n", stats->mode_cmds);
+	printf("TX frames: %" G_GINT64_MODIFIER "u  RX frames: %" G_GINT64_MODIFIER "u  Matched: %" G_GINT64_MODIFIER
+		"u  Lost (> %.0f s): %" G_GINT64_MODIFIER "u  In flight: %" G_GINT64_MODIFIER "u\n",
+		stats->tx, stats->rx, stats->matched, LOOPBACK_TIMEOUT, stats->lost,
+		stats->tx - stats->matched - stats->lost);
+	if (stats->matched != 0)
+		printf("Latency (us): min %.1f, avg %.1f, max %.1f\n", stats->min_ns / 1e3,
+			(double)stats->sum_ns / stats->matched / 1e3, stats->max_ns / 1e3);
 
-	pdu_type = tvb_get_letohl(tvb, offset);
+	if (stats->list_frames && stats->matches->len != 0) {
+		printf("\nTX frame   RX frame   Latency (us)\n");
+		for (i = 0; i < stats->matches->len; i++) {
+			const loopback_match *match = &g_array_index(stats->matches, loopback_match, i);
 
-	switch (pdu_type) {
-	case 0: dissect_fw_type_0(tree, tvb, offset, pinfo); break;
-	case 1: case 4: dissect_fw_type_1_4(tree, tvb, offset, pinfo); break;
-	case 0x4D434257: dissect_topdog_mcbw(tree, tvb, offset, pinfo); break;
-	case 0x4D435357: dissect_topdog_mcsw(tree, tvb, offset, pinfo); break;
-	case 0x4D545844: dissect_topdog_mtxd(tree, tvb, offset, pinfo); break;
-	case 0x4D525844: dissect_topdog_mrxd(tree, tvb, offset, pinfo); break;
+			printf("%8u %10u %14.1f\n", match->tx_frame, match->rx_frame, match->latency_ns / 1e3);
+		}
 	}
+
+	printf("\nLatency (us)          Frames   Cumulative\n");
+	for (i = 0; i < LOOPBACK_BUCKETS; i++) {
+		if (stats->buckets[i] == 0)
+			continue;
+		sum += stats->buckets[i];
+		printf("%7u - %-9u %10" G_GINT64_MODIFIER "u   %9.1f%%\n", i ? 1u << i : 0, 2u << i,
+			stats->buckets[i], percent(sum, stats->matched));
+	}
+	printf("===================================================================\n");
 }
 
-static int dissect_topdog(tvbuff_t *tvb, packet_info *pinfo,
-	proto_tree *tree, void *data)
+static void loopback_init(const char *opt_arg, void *userdata)
 {
-	col_set_str(pinfo->cinfo, COL_PROTOCOL, "TOPDOG");
+	loopback_stats *stats = g_new0(loopback_stats, 1);
+	GString *error_string;
+	const char *arg = NULL;
 
-	if (tree) {
-		proto_item *topdog_item = NULL;
-		proto_tree *topdog_tree = NULL;
+	if (strncmp(opt_arg, "topdog,loopback,", 16) == 0)
+		arg = opt_arg + 16;
+	if (arg != NULL && strncmp(arg, "frames", 6) == 0 && (arg[6] == '\0' || arg[6] == ',')) {
+		stats->list_frames = TRUE;
+		stats->matches = g_array_new(FALSE, FALSE, sizeof(loopback_match));
+		arg = arg[6] == ',' ? arg + 7 : NULL;
+	}
+	if (arg != NULL)
+		stats->filter = g_strdup(arg);
+	stats->keys = g_hash_table_new_full(g_int64_hash, g_int64_equal, NULL, g_free);
+	g_queue_init(&stats->pending);
 
-		topdog_item = proto_tree_add_item(tree, proto_topdog, tvb, 0, -1, ENC_NA);
-		topdog_tree = proto_item_add_subtree(topdog_item, ett_topdog);
+	error_string = register_tap_listener("topdog", stats, stats->filter, 0,
+		loopback_reset, loopback_cmd_packet, loopback_draw);
+	if (error_string == NULL)
+		error_string = register_tap_listener("topdog.tx", stats, stats->filter, 0,
+			NULL, loopback_tx_packet, NULL);
+	if (error_string == NULL)
+		error_string = register_tap_listener("topdog.rx", stats, stats->filter, 0,
+			NULL, loopback_rx_packet, NULL);
+	if (error_string) {
+		fprintf(stderr, "tshark: Couldn't register topdog,loopback tap: %s\n", error_string->str);
+		g_string_free(error_string, TRUE);
+		exit(1);
+	}
+}
+
+static stat_tap_ui loopback_ui = {
+	REGISTER_STAT_GROUP_GENERIC,
+	NULL,
+	"topdog,loopback",
+	loopback_init,
+	0,
+	NULL
+};
+
+/* -z topdog,export,<file>[,filter]
+** Streams one fixed-width little-endian record per RxPD/WCB to <file>, so the
+** output can be memory-mapped as a structured array. The header is:
+**   magic "TDDESC\0\0", u32 version, u32 header length, u32 record length,
+**   u32 column count, u64 record count (filled in at the end),
+** followed by one 20-byte entry per column:
+**   char name[16], u8 type (1 = uint, 2 = bytes), u8 size, u16 offset.
+** Fields a descriptor doesn't carry (e.g. RSSI on TX) are zero. */
+#define DESCEXPORT_VERSION	1
+#define DESCEXPORT_RECORD_LEN	32
+#define DESCEXPORT_HEADER_LEN	(32 + 20 * array_length(descexport_columns))
+
+typedef struct _descexport_column {
+	const char *name;
+	guint8 type;
+	guint8 size;
+	guint16 offset;
+} descexport_column;
+
+static const descexport_column descexport_columns[] = {
+	{"timestamp_ns", 1, 8, 0},
+	{"frame", 1, 4, 8},
+	{"direction", 1, 1, 12},	/* 0 = RX (MRXD), 1 = TX (MTXD) */
+	{"rssi", 1, 1, 13},
+	{"noise_lvl", 1, 1, 14},
+	{"channel", 1, 1, 15},
+	{"qos_ctrl", 1, 2, 16},
+	{"rate_info", 1, 2, 18},
+	{"rxpd_ctrl", 1, 2, 20},
+	{"pkt_len", 1, 2, 22},
+	{"dest_mac", 2, 6, 24}
+};
+
+typedef struct _descexport_stats {
+	char *filename;
+	char *filter;
+	FILE *fp;
+	guint64 count;
+} descexport_stats;
+
+static void put_le(guint8 *p, guint64 v, int size)
+{
+	int i;
+
+	for (i = 0; i < size; i++, v >>= 8)
+		p[i] = (guint8)v;
+}
+
+static void descexport_write_header(descexport_stats *stats)
+{
+	guint8 header[DESCEXPORT_HEADER_LEN];
+	guint i;
+
+	memset(header, 0, sizeof header);
+	memcpy(header, "TDDESC\0\0", 8);
+	put_le(header+8, DESCEXPORT_VERSION, 4);
+	put_le(header+12, DESCEXPORT_HEADER_LEN, 4);
+	put_le(header+16, DESCEXPORT_RECORD_LEN, 4);
+	put_le(header+20, array_length(descexport_columns), 4);
+	put_le(header+24, stats->count, 8);
+	for (i = 0; i < array_length(descexport_columns); i++) {
+		guint8 *col = header + 32 + 20 * i;
 
-		dissect_pdu(topdog_tree, tvb, 0, pinfo);
+		strncpy((char *)col, descexport_columns[i].name, 16);
+		col[16] = descexport_columns[i].type;
+		col[17] = descexport_columns[i].size;
+		put_le(col+18, descexport_columns[i].offset, 2);
 	}
 
-	return tvb_captured_length(tvb);
+	fwrite(header, 1, sizeof header, stats->fp);
 }
 
-static gboolean
-dissect_topdog_bulk_heur(tvbuff_t *tvb, packet_info *pinfo, proto_tree *tree, void *data)
+static void descexport_write(descexport_stats *stats, packet_info *pinfo, guint8 *rec)
 {
-	usb_conv_info_t *usb_conv_info = (usb_conv_info_t *)data;
-	const guint8 mcbw[] = {0x57, 0x42, 0x43, 0x4D};
-	const guint8 mcsw[] = {0x57, 0x53, 0x43, 0x4D};
-	const guint8 mtxd[] = {0x44, 0x58, 0x54, 0x4D};
-	const guint8 mrxd[] = {0x44, 0x58, 0x52, 0x4D};
+	put_le(rec+0, (guint64)pinfo->abs_ts.secs * 1000000000 + pinfo->abs_ts.nsecs, 8);
+	put_le(rec+8, pinfo->num, 4);
+	fwrite(rec, 1, DESCEXPORT_RECORD_LEN, stats->fp);
+	stats->count++;
+}
 
-	if (usb_conv_info != NULL
-		&& usb_conv_info->deviceVendor == 0x07d1
-		&& usb_conv_info->deviceProduct == 0x3b11) {
-		dissect_topdog(tvb, pinfo, tree, data);
-		return TRUE;
+static void descexport_reset(void *tapdata)
+{
+	descexport_stats *stats = (descexport_stats *)tapdata;
+
+	stats->count = 0;
+	rewind(stats->fp);
+	descexport_write_header(stats);
+}
+
+static gboolean descexport_rx_packet(void *tapdata, packet_info *pinfo, epan_dissect_t *edt, const void *data)
+{
+	const topdog_rx_info *rx = (const topdog_rx_info *)data;
+	guint8 rec[DESCEXPORT_RECORD_LEN];
+
+	memset(rec, 0, sizeof rec);
+	rec[13] = rx->rssi;
+	rec[14] = rx->noise_lvl;
+	rec[15] = rx->channel;
+	put_le(rec+16, rx->qos_ctrl, 2);
+	put_le(rec+18, rx->rx_rate_info, 2);
+	put_le(rec+20, rx->rxpd_ctrl, 2);
+	put_le(rec+22, rx->pkt_len, 2);
+	descexport_write((descexport_stats *)tapdata, pinfo, rec);
+
+	return FALSE;
+}
+
+static gboolean descexport_tx_packet(void *tapdata, packet_info *pinfo, epan_dissect_t *edt, const void *data)
+{
+	const topdog_tx_info *tx = (const topdog_tx_info *)data;
+	guint8 rec[DESCEXPORT_RECORD_LEN];
+
+	memset(rec, 0, sizeof rec);
+	rec[12] = 1;
+	put_le(rec+16, tx->qos_ctrl, 2);
+	put_le(rec+18, tx->rate_info, 2);
+	put_le(rec+22, tx->pkt_len, 2);
+	memcpy(rec+24, tx->dest_mac, 6);
+	descexport_write((descexport_stats *)tapdata, pinfo, rec);
+
+	return FALSE;
+}
+
+/* Both listeners share the writer; patching the record count in the header
+** is idempotent, so it doesn't matter which draw callback runs last. */
+static void descexport_draw(void *tapdata)
+{
+	descexport_stats *stats = (descexport_stats *)tapdata;
+	guint8 count[8];
+	long end;
+
+	fflush(stats->fp);
+	end = ftell(stats->fp);
+	put_le(count, stats->count, 8);
+	if (fseek(stats->fp, 24, SEEK_SET) == 0) {
+		fwrite(count, 1, sizeof count, stats->fp);
+		fseek(stats->fp, end, SEEK_SET);
+	}
+	fflush(stats->fp);
+}
+
+static void descexport_init(const char *opt_arg, void *userdata)
+{
+	descexport_stats *stats = g_new0(descexport_stats, 1);
+	GString *error_string;
+	const char *filter;
+
+	if (strncmp(opt_arg, "topdog,export,", 14) != 0 || opt_arg[14] == '\0') {
+		fprintf(stderr, "tshark: invalid \"-z topdog,export,<file>[,filter]\" argument\n");
+		exit(1);
+	}
+	filter = strchr(opt_arg + 14, ',');
+	if (filter != NULL) {
+		stats->filename = g_strndup(opt_arg + 14, filter - (opt_arg + 14));
+		stats->filter = g_strdup(filter + 1);
+	} else {
+		stats->filename = g_strdup(opt_arg + 14);
+	}
+
+	stats->fp = fopen(stats->filename, "wb");
+	if (stats->fp == NULL) {
+		fprintf(stderr, "tshark: Couldn't open %s for writing\n", stats->filename);
+		exit(1);
+	}
+	descexport_write_header(stats);
+
+	error_string = register_tap_listener("topdog.rx", stats, stats->filter, 0,
+		descexport_reset, descexport_rx_packet, descexport_draw);
+	if (error_string == NULL)
+		error_string = register_tap_listener("topdog.tx", stats, stats->filter, 0,
+			NULL, descexport_tx_packet, descexport_draw);
+	if (error_string) {
+		fprintf(stderr, "tshark: Couldn't register topdog,export tap: %s\n", error_string->str);
+		g_string_free(error_string, TRUE);
+		exit(1);
 	}
+}
+
+static stat_tap_ui descexport_ui = {
+	REGISTER_STAT_GROUP_GENERIC,
+	NULL,
+	"topdog,export",
+	descexport_init,
+	0,
+	NULL
+};
+
+/* -z topdog,radiotap,<file>[,filter]
+** Writes the 802.11 frame behind every RxPD and WCB to a pcap file with
+** LINKTYPE_IEEE802_11_RADIOTAP, so Wi-Fi tools can read it without this
+** plugin. RX frames carry the channel, signal, noise and rate from the RxPD;
+** TX frames carry the WCB's rate and a TX flags field, which marks them as
+** transmitted. Frames cut short by the snaplen keep their original length. */
+#define LINKTYPE_IEEE802_11_RADIOTAP	127
+#define RADIOTAP_MAX_LEN	32
+
+#define RADIOTAP_RATE	2
+#define RADIOTAP_CHANNEL	3
+#define RADIOTAP_DBM_ANTSIGNAL	5
+#define RADIOTAP_DBM_ANTNOISE	6
+#define RADIOTAP_TX_FLAGS	15
+#define RADIOTAP_MCS	19
+
+typedef struct _radiotap_stats {
+	char *filename;
+	char *filter;
+	FILE *fp;
+} radiotap_stats;
+
+typedef struct _radiotap_hdr {
+	guint8 data[RADIOTAP_MAX_LEN];
+	guint len;
+	guint32 present;
+} radiotap_hdr;
+
+/* Appends a radiotap field after padding to its alignment. Fields must be
+** added in order of their present bits. */
+static void radiotap_put(radiotap_hdr *hdr, guint32 bit, guint align, guint64 v, guint size)
+{
+	while (hdr->len % align)
+		hdr->data[hdr->len++] = 0;
+	put_le(hdr->data + hdr->len, v, size);
+	hdr->len += size;
+	hdr->present |= 1u << bit;
+}
+
+/* Legacy rates go in the rate field, which comes first... */
+static void radiotap_put_rate(radiotap_hdr *hdr, guint16 rate_info)
+{
+	guint32 kbps = phy_rates[TOPDOG_RATE_INDEX(rate_info)].kbps;
+
+	if (!TOPDOG_RATE_HT(rate_info) && kbps != 0)
+		radiotap_put(hdr, RADIOTAP_RATE, 1, kbps / 500, 1);
+}
+
+/* ...and HT rates in the MCS field, which comes last. */
+static void radiotap_put_mcs(radiotap_hdr *hdr, guint16 rate_info)
+{
+	guint32 flags = (TOPDOG_RATE_BW40(rate_info) ? 0x01 : 0) | (TOPDOG_RATE_SHORT_GI(rate_info) ? 0x04 : 0);
+
+	/* known (bandwidth, MCS, guard interval), flags, MCS index */
+	if (TOPDOG_RATE_HT(rate_info))
+		radiotap_put(hdr, RADIOTAP_MCS, 1, 0x07 | flags << 8 | TOPDOG_RATE_MCS(rate_info) << 16, 3);
+}
+
+static void radiotap_write_header(radiotap_stats *stats)
+{
+	guint8 header[24];
+
+	put_le(header+0, 0xa1b23c4d, 4);	/* nanosecond timestamps */
+	put_le(header+4, 2, 2);
+	put_le(header+6, 4, 2);
+	put_le(header+8, 0, 4);
+	put_le(header+12, 0, 4);
+	put_le(header+16, 65535 + RADIOTAP_MAX_LEN, 4);
+	put_le(header+20, LINKTYPE_IEEE802_11_RADIOTAP, 4);
+	fwrite(header, 1, sizeof header, stats->fp);
+}
+
+static void radiotap_write(radiotap_stats *stats, packet_info *pinfo, radiotap_hdr *hdr,
+	tvbuff_t *tvb, guint32 wlan_offset, gint wlan_len)
+{
+	guint8 rec[16];
+	gint caplen = MIN(wlan_len, tvb_captured_length_remaining(tvb, wlan_offset));
+
+	/* version 0, pad, length, present */
+	put_le(hdr->data+0, 0, 2);
+	put_le(hdr->data+2, hdr->len, 2);
+	put_le(hdr->data+4, hdr->present, 4);
+
+	put_le(rec+0, pinfo->abs_ts.secs, 4);
+	put_le(rec+4, pinfo->abs_ts.nsecs, 4);
+	put_le(rec+8, hdr->len + caplen, 4);
+	put_le(rec+12, hdr->len + wlan_len, 4);
+	fwrite(rec, 1, sizeof rec, stats->fp);
+	fwrite(hdr->data, 1, hdr->len, stats->fp);
+	fwrite(tvb_get_ptr(tvb, wlan_offset, caplen), 1, caplen, stats->fp);
+}
+
+static void radiotap_reset(void *tapdata)
+{
+	radiotap_stats *stats = (radiotap_stats *)tapdata;
+
+	rewind(stats->fp);
+	radiotap_write_header(stats);
+}
 
-	if (tvb_reported_length(tvb) < 4)
+static gboolean radiotap_rx_packet(void *tapdata, packet_info *pinfo, epan_dissect_t *edt, const void *data)
+{
+	const topdog_rx_info *rx = (const topdog_rx_info *)data;
+	radiotap_hdr hdr;
+
+	if (rx->wlan_len <= 0)
 		return FALSE;
 
-	if (!tvb_memeql(tvb, 0, mcbw, 4)
-		|| !tvb_memeql(tvb, 0, mcsw, 4)
-		|| !tvb_memeql(tvb, 0, mtxd, 4)
-		|| !tvb_memeql(tvb, 0, mrxd, 4)) {
-		dissect_topdog(tvb, pinfo, tree, data);
-		return TRUE;
+	hdr.len = 8;
+	hdr.present = 0;
+	radiotap_put_rate(&hdr, rx->rx_rate_info);
+	if (rx->channel != 0) {
+		guint32 mhz, flags;
+
+		if (rx->channel <= 14) {
+			mhz = rx->channel == 14 ? 2484 : 2407 + 5 * rx->channel;
+			flags = 0x0080;	/* 2 GHz */
+		} else {
+			mhz = 5000 + 5 * rx->channel;
+			flags = 0x0100;	/* 5 GHz */
+		}
+		radiotap_put(&hdr, RADIOTAP_CHANNEL, 2, mhz | flags << 16, 4);
 	}
+	radiotap_put(&hdr, RADIOTAP_DBM_ANTSIGNAL, 1, (guint8)-rx->rssi, 1);
+	radiotap_put(&hdr, RADIOTAP_DBM_ANTNOISE, 1, (guint8)-rx->noise_lvl, 1);
+	radiotap_put_mcs(&hdr, rx->rx_rate_info);
+	radiotap_write((radiotap_stats *)tapdata, pinfo, &hdr, rx->tvb, rx->wlan_offset, rx->wlan_len);
+
+	return FALSE;
+}
+
+static gboolean radiotap_tx_packet(void *tapdata, packet_info *pinfo, epan_dissect_t *edt, const void *data)
+{
+	const topdog_tx_info *tx = (const topdog_tx_info *)data;
+	radiotap_hdr hdr;
+
+	if (tx->wlan_len <= 0)
+		return FALSE;
+
+	hdr.len = 8;
+	hdr.present = 0;
+	radiotap_put_rate(&hdr, tx->rate_info);
+	radiotap_put(&hdr, RADIOTAP_TX_FLAGS, 2, 0, 2);
+	radiotap_put_mcs(&hdr, tx->rate_info);
+	radiotap_write((radiotap_stats *)tapdata, pinfo, &hdr, tx->tvb, tx->wlan_offset, tx->wlan_len);
 
 	return FALSE;
 }
 
+static void radiotap_draw(void *tapdata)
+{
+	fflush(((radiotap_stats *)tapdata)->fp);
+}
+
+static void radiotap_init(const char *opt_arg, void *userdata)
+{
+	radiotap_stats *stats = g_new0(radiotap_stats, 1);
+	GString *error_string;
+	const char *filter;
+
+	if (strncmp(opt_arg, "topdog,radiotap,", 16) != 0 || opt_arg[16] == '\0') {
+		fprintf(stderr, "tshark: invalid \"-z topdog,radiotap,<file>[,filter]\" argument\n");
+		exit(1);
+	}
+	filter = strchr(opt_arg + 16, ',');
+	if (filter != NULL) {
+		stats->filename = g_strndup(opt_arg + 16, filter - (opt_arg + 16));
+		stats->filter = g_strdup(filter + 1);
+	} else {
+		stats->filename = g_strdup(opt_arg + 16);
+	}
+
+	stats->fp = fopen(stats->filename, "wb");
+	if (stats->fp == NULL) {
+		fprintf(stderr, "tshark: Couldn't open %s for writing\n", stats->filename);
+		exit(1);
+	}
+	radiotap_write_header(stats);
+
+	error_string = register_tap_listener("topdog.rx", stats, stats->filter, 0,
+		radiotap_reset, radiotap_rx_packet, radiotap_draw);
+	if (error_string == NULL)
+		error_string = register_tap_listener("topdog.tx", stats, stats->filter, 0,
+			NULL, radiotap_tx_packet, radiotap_draw);
+	if (error_string) {
+		fprintf(stderr, "tshark: Couldn't register topdog,radiotap tap: %s\n", error_string->str);
+		g_string_free(error_string, TRUE);
+		exit(1);
+	}
+}
+
+static stat_tap_ui radiotap_ui = {
+	REGISTER_STAT_GROUP_GENERIC,
+	NULL,
+	"topdog,radiotap",
+	radiotap_init,
+	0,
+	NULL
+};
+
+static void topdog_init(void)
+{
+	topdog_dev_infos = wmem_map_new(wmem_file_scope(), g_direct_hash, g_direct_equal);
+	topdog_heur_states = wmem_map_new(wmem_file_scope(), g_direct_hash, g_direct_equal);
+}
+
+UAT_HEX_CB_DEF(topdog_devices, vid, topdog_device_t)
+UAT_HEX_CB_DEF(topdog_devices, pid, topdog_device_t)
+
+static gboolean topdog_device_update_cb(void *r, char **err)
+{
+	topdog_device_t *rec = (topdog_device_t *)r;
+
+	if (rec->vid > 0xffff || rec->pid > 0xffff) {
+		*err = g_strdup("Vendor and product IDs must be 16-bit values");
+		return FALSE;
+	}
+
+	return TRUE;
+}
+
+static void add_topdog_product(guint32 product)
+{
+	g_hash_table_add(topdog_products, GUINT_TO_POINTER(product));
+	dissector_add_uint("usb.product", product, topdog_product_handle);
+}
+
+static void remove_topdog_product(gpointer key, gpointer value, gpointer user_data)
+{
+	dissector_delete_uint("usb.product", GPOINTER_TO_UINT(key), topdog_product_handle);
+}
+
+/* Rebuilds the product set and the usb.product registrations from the UAT. */
+static void topdog_devices_post_update_cb(void)
+{
+	guint i;
+
+	g_hash_table_foreach(topdog_products, remove_topdog_product, NULL);
+	g_hash_table_remove_all(topdog_products);
+
+	add_topdog_product(TOPDOG_USB_PRODUCT(TOPDOG_DEFAULT_VID, TOPDOG_DEFAULT_PID));
+	for (i = 0; i < num_topdog_devices; i++)
+		add_topdog_product(TOPDOG_USB_PRODUCT(topdog_devices[i].vid, topdog_devices[i].pid));
+}
+
 void plugin_register(void)
 {
+	module_t *topdog_module;
+	uat_t *topdog_devices_uat;
+	static uat_field_t topdog_device_fields[] = {
+		UAT_FLD_HEX(topdog_devices, vid, "Vendor ID", "USB vendor ID (hex)"),
+		UAT_FLD_HEX(topdog_devices, pid, "Product ID", "USB product ID (hex)"),
+		UAT_END_FIELDS
+	};
+
 	proto_topdog = proto_register_protocol("Marvell TopDog 88W8362", "TopDog", "topdog");
 	proto_register_field_array(proto_topdog, hf, array_length(hf));
 	proto_register_subtree_array(ett_list, array_length(ett_list));
+	expert_register_field_array(expert_register_protocol(proto_topdog), ei, array_length(ei));
+
+	topdog_handle = create_dissector_handle(dissect_topdog, proto_topdog);
+	topdog_product_handle = create_dissector_handle(dissect_topdog_product, proto_topdog);
+	crc32_slice_init();
+	phy_rate_init();
+	build_cmd_table();
+	register_init_routine(topdog_init);
+	topdog_tap = register_tap("topdog");
+	topdog_rx_tap = register_tap("topdog.rx");
+	topdog_tx_tap = register_tap("topdog.tx");
+	register_stat_tap_ui(&fwload_ui, NULL);
+	register_stat_tap_ui(&rxstats_ui, NULL);
+	register_stat_tap_ui(&airtime_ui, NULL);
+	register_stat_tap_ui(&rateconv_ui, NULL);
+	register_stat_tap_ui(&scan_ui, NULL);
+	register_stat_tap_ui(&loopback_ui, NULL);
+	register_stat_tap_ui(&urbstats_ui, NULL);
+	register_stat_tap_ui(&txring_ui, NULL);
+	register_stat_tap_ui(&descexport_ui, NULL);
+	register_stat_tap_ui(&radiotap_ui, NULL);
+	register_srt_table(proto_topdog, "topdog", 1, topdog_srt_packet, topdog_srt_init, NULL);
+	topdog_eo_tap = register_export_object(proto_topdog, topdog_eo_packet, NULL);
+	topdog_products = g_hash_table_new(g_direct_hash, g_direct_equal);
+
+	topdog_module = prefs_register_protocol(proto_topdog, NULL);
+	topdog_devices_uat = uat_new("TopDog USB devices",
+		sizeof(topdog_device_t),
+		"topdog_usb_devices",
+		TRUE,
+		&topdog_devices,
+		&num_topdog_devices,
+		UAT_AFFECTS_DISSECTION,
+		NULL,
+		NULL,
+		topdog_device_update_cb,
+		NULL,
+		topdog_devices_post_update_cb,
+		topdog_device_fields);
+	prefs_register_uint_preference(topdog_module, "max_pending_cmds",
+		"Maximum outstanding commands per device",
+		"Commands awaiting a response beyond this many are dropped, oldest first (0 = unlimited)",
+		10, &topdog_max_pending_cmds);
+	prefs_register_uint_preference(topdog_module, "max_fw_image_kb",
+		"Maximum firmware image size (KiB)",
+		"Firmware reassembly is abandoned for images larger than this (0 = unlimited)",
+		10, &topdog_max_fw_image_kb);
+	prefs_register_uat_preference(topdog_module, "usb_devices", "USB devices",
+		"Additional USB vendor/product ID pairs to decode as TopDog",
+		topdog_devices_uat);
+
 	printf("wireshark-topdog-dissector: Reached plugin_register.\n");
 }
 
 void plugin_reg_handoff(void)
 {
+	topdog_devices_post_update_cb();
 	heur_dissector_add("usb.bulk", dissect_topdog_bulk_heur, "Marvell TopDog 88W8362 USB bulk endpoint", "topdog_usb_bulk", proto_topdog, HEURISTIC_ENABLE);
 	/* TODO: Is there a way to tell Wireshark that the 802.11 header is
 	** *always* the 4-address format and *never* has the QoS Control field?